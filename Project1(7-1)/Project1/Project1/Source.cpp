@@ -1,5 +1,10 @@
 #include <iostream>         // cout, cerr
 #include <cstdlib>          // EXIT_FAILURE
+#include <chrono>           // picking timing
+#include <algorithm>        // min, max
+#include <cmath>            // floor, log2
+#include <deque>            // inputs waiting to be presented
+#include <mutex>            // input shared with the simulation thread
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
 #define STB_IMAGE_IMPLEMENTATION
@@ -12,6 +17,18 @@
 
 #include "meshes(1).h"
 #include "camera.h"
+#include "scene.h"
+#include "shaderprogram.h"
+#include "lightclusters.h"
+#include "gbuffer.h"
+#include "shadowmaps.h"
+#include "pointshadows.h"
+#include "overdrawcounters.h"
+#include "renderstate.h"
+#include "framering.h"
+#include "rendercommands.h"
+#include "workerpool.h"
+#include "simulation.h"
 
 
 using namespace std; // Standard namespace
@@ -31,6 +48,14 @@ namespace
 	const int WINDOW_WIDTH = 800;
 	const int WINDOW_HEIGHT = 600;
 
+	// Size of the default framebuffer, kept up to date by UResizeWindow
+	int gFramebufferWidth = WINDOW_WIDTH;
+	int gFramebufferHeight = WINDOW_HEIGHT;
+
+	// Depth range of both projections, also the depth range split into light clusters
+	const float NEAR_PLANE = 0.1f;
+	const float FAR_PLANE = 100.0f;
+
 	// Stores the GL data relative to a given mesh
 	struct GLMesh
 	{
@@ -47,60 +72,229 @@ namespace
 	GLMesh gMesh;
 
 	// Texture id
-	GLuint gTextureIdGrass;
-	GLuint gTextureIdSidewalk;
-	GLuint gTextureIdLampBase;
-	GLuint gTextureIdLampLight;
-	GLuint gTextureIdPot;
-	GLuint gTextureIdDirt;
-	GLuint gTextureIdBark;
-	GLuint gTextureIdLeaves;
-	GLuint gTextureIdStem;
-	GLuint gTextureIdBrick;
-	GLuint gTextureId;
-
-	//texture wrapping 
-	GLint gTexWrapMode = GL_REPEAT;
-
-	//UV scalle to allow thesizing of diffrent textures 
-	glm::vec2 gUVScale(1.0f, 1.0f);
+	GLuint gTextureIdMaterials;     // GL_TEXTURE_2D_ARRAY, one layer per scene material
+
+	// Every material is resampled to this size to become a layer of gTextureIdMaterials
+	const int MATERIAL_LAYER_SIZE = 1024;
+
+	// Texture unit the lit and G-buffer shaders sample gTextureIdMaterials from, after the point shadows
+	const GLint MATERIAL_ARRAY_UNIT = 5;
+
+	// Vertex layout of the meshes; the packed one halves the vertex bandwidth of the integrated GPUs
+	const MeshVertexFormat MESH_VERTEX_FORMAT = MESH_VERTEX_FORMAT_PACKED;
 
 	// Shader program, one for the normal shapes and for the light sources
-	GLuint gProgramId;
-	GLuint gLampProgramId;
+	ShaderProgram gProgram;
+	ShaderProgram gLampProgram;
+
+	// Programs of the deferred path: geometry pass for both kinds of objects,
+	// then the sun over the whole screen and every point light over its rectangle
+	ShaderProgram gGBufferProgram;
+	ShaderProgram gLampGBufferProgram;
+	ShaderProgram gDeferredSunProgram;
+	ShaderProgram gDeferredLightProgram;
+
+	// Depth only program laying down the depth of the view before shading it
+	ShaderProgram gDepthPrepassProgram;
+
+	// Depth only program drawing the objects into the sun's shadow cascades
+	ShaderProgram gShadowProgram;
+	// and the one drawing them into the cube faces of the point light shadows
+	ShaderProgram gPointShadowProgram;
+
+	// Crosshair at the screen center, where clicks pick while the cursor is captured by mouse look
+	ShaderProgram gCrosshairProgram;
+	const float CROSSHAIR_SIZE = 8.0f;     // pixels from the center to the end of each line
+
+	// Uniform locations of the programs, resolved once after linking
+	struct LitUniforms
+	{
+		GLint drawIdOffset;
+		GLint uTexture;
+		GLint uShadowMap;   // -1 for programs that do not sample the shadows
+		GLint uPointShadowMaps;
+	};
+	struct LampUniforms
+	{
+		GLint drawIdOffset;
+	};
+	struct DeferredUniforms
+	{
+		GLint gAlbedo;
+		GLint gNormal;
+		GLint gDepth;
+		GLint uShadowMap;   // -1 for programs that do not sample the shadows
+		GLint uPointShadowMaps;
+	};
+	struct CrosshairUniforms
+	{
+		GLint crosshairSize;
+	};
+	LitUniforms gLitUniforms;
+	LampUniforms gLampUniforms;
+	LitUniforms gGBufferUniforms;
+	LampUniforms gLampGBufferUniforms;
+	LampUniforms gDepthPrepassUniforms;
+	DeferredUniforms gDeferredSunUniforms;
+	DeferredUniforms gDeferredLightUniforms;
+	LampUniforms gShadowUniforms;
+	LampUniforms gPointShadowUniforms;
+	CrosshairUniforms gCrosshairUniforms;
+
+	// Camera and lighting values shared by every program, std140 layout of the
+	// FrameConstants uniform block; vec3 members are padded to 16 bytes
+	struct FrameConstants
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::mat4 inverseViewProjection;   // rebuilds world positions from depth in the deferred passes
+		glm::vec3 viewPosition;
+		float padding0;
+		glm::vec3 lightColor;
+		float padding1;
+		glm::vec3 lightPos;
+		float padding2;
+		glm::vec3 keyLightColor;    // multiplies the color of every point light
+		float padding3;
+		glm::uvec4 clusterGrid;     // light clusters along x, y and depth
+		glm::vec4 clusterParams;    // framebuffer width and height, depth slice scale and bias
+	};
+	const GLuint FRAME_CONSTANTS_BINDING = 0;
+	FrameConstants gFrameConstants;
+
+	// Light view of the cascade or cube face being drawn, std140 layout of the
+	// ShadowPassConstants uniform block of the shadow programs
+	struct ShadowPassConstants
+	{
+		glm::mat4 lightViewProjection;
+		glm::vec4 lightSphere;      // position and radius of a point light, unused for the sun
+	};
+	const GLuint SHADOW_PASS_CONSTANTS_BINDING = 2;
 
-	// camera
+	// camera; the simulation thread moves its own, this copy is the one of the frame being drawn
 	Camera gCamera(glm::vec3(0.0f, 10.0f, 50.0f));
 	float gLastX = WINDOW_WIDTH / 2.0f;
 	float gLastY = WINDOW_HEIGHT / 2.0f;
 	bool gFirstMouse = true;
 
-	// timing
-	float gDeltaTime = 0.0f; // time between current frame and last frame
-	float gLastFrame = 0.0f;
+	// Input is polled on the main thread, where GLFW delivers it, and consumed by the next simulation step
+	struct SimulationInput
+	{
+		bool keys[GLFW_KEY_LAST + 1];   // held down at the last poll
+		float mouseX, mouseY;           // cursor movement since the last step
+		float scroll;                   // scrolling since the last step
+		unsigned sequence;              // counts the polls that brought new input
+	};
+	SimulationInput gInput = {};
+	std::mutex gInputMutex;
+
+	// Keys the simulation reacts to; Escape and the info key stay on the main thread
+	const int SIMULATION_KEYS[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E,
+		GLFW_KEY_O, GLFW_KEY_P, GLFW_KEY_RIGHT, GLFW_KEY_LEFT, GLFW_KEY_F, GLFW_KEY_G, GLFW_KEY_Z, GLFW_KEY_X,
+		GLFW_KEY_LEFT_BRACKET, GLFW_KEY_RIGHT_BRACKET };
+	bool gMouseInput = false;           // a mouse callback ran during the last poll
+
+	// Everything the simulation decides and the frame draws, published after every step
+	struct SimulationState
+	{
+		Camera camera{ glm::vec3(0.0f, 10.0f, 50.0f) };
+		bool perspective = false;
+		GLenum polygonMode = GL_FILL;
+		bool deferred = false;
+		bool depthPrepass = false;
+		glm::vec3 lightColor{ 1.0f, 1.0f, 1.0f };
+		glm::vec3 keyLightColor{ 0.0f, 0.0f, 0.0f };
+		unsigned inputSequence = 0;     // newest input the state reflects
+	};
+
+	// The simulation steps at a fixed rate on its own thread, so the next state is prepared while a frame is drawn
+	const double SIMULATION_STEP = 1.0 / 120.0;
+	FixedStepThread gSimulation;
+	SimulationState gSimulationState;   // simulation thread only
+	StateDoubleBuffer<SimulationState> gSimulationStates;
+	unsigned gRenderStateSequence = 0;  // inputSequence of the state the current frame draws
+
+	// Inputs are timed from the poll that saw them to the return of the swap that presents them
+	struct PendingInput
+	{
+		unsigned sequence;
+		double time;
+	};
+	std::deque<PendingInput> gPendingInputs;
+	LatencyStats gInputLatency;
+
+	// The values below are copied from the newest simulation state at the start of every frame
 
 	//set as false for the ortho view, can be modified by user with o/p keys
 	bool perspective = false;
 
+	//forward shading by default, the f/g keys switch to the deferred path and back
+	bool gDeferred = false;
+	bool gDeferredAvailable = true;     // cleared when the G-buffer cannot be created
+	GBuffer gGBuffer;
+	GLuint gFullscreenVao = 0;     // no attributes, the passes build their vertices from gl_VertexID
+
+	//fill or line, changed with the left/right arrow keys; the deferred lighting passes always fill
+	GLenum gPolygonMode = GL_FILL;
+
+	//depth pre-pass before shading, switched on and off with the z/x keys; i prints the overdraw counters
+	bool gDepthPrepass = false;
+	OverdrawCounters gOverdrawCounters;
+
+	// Every program, vertex array, framebuffer and texture bind of a frame goes through it
+	RenderStateCache gStateCache;
+
+	// Constants, culling results, indirect commands and light lists of the frame are written here
+	FrameRing gFrameRing;
+
+	// A view of the frame: a stale shadow cascade, a cube face of the budget or a slice of the camera.
+	// Workers cull each view and record its passes; the main thread, which owns the GL context,
+	// executes them from the merged queue
+	struct FrameView
+	{
+		glm::mat4 viewProjection;
+		int cascade;                    // sun cascade the view draws, or -1
+		int face;                       // entry of gPointShadowMaps.faceUpdates it draws, or -1; both -1 for the camera
+		int pass;                       // first pass of the view, the camera shades in the next one
+		int slice;                      // slice of the camera the view is, 0 for shadow views
+		int bvhRoot;                    // BVH node whose subtree the view culls, the root but for camera slices
+		SceneView scene;
+		RenderCommandList commands;
+	};
+	std::vector<FrameView> gFrameViews; // only the first gFrameViewCount are views of this frame
+	int gFrameViewCount = 0;
+
+	// The camera is cut into at most this many BVH subtrees, culled and recorded on different threads
+	const int CAMERA_SLICE_COUNT = 4;
+	std::vector<int> gCameraSliceRoots;
+	int gCameraSliceCount = 1;
+	WorkerPool gWorkerPool;
+	RenderCommandQueue gCommandQueue;
+
 	//Shape Meshes from Professor Brian
 	Meshes meshes;
 
-	//default color 
-	glm::vec3 gObjectColor(1.f, 1.0f, 1.0f);
+	//Objects of the garden, loaded from the scene file
+	const char* const SCENE_FILENAME = "garden.scene";
+	Scene gScene;
+
+	// Point lights of the scene, sorted into clusters every frame
+	std::vector<PointLight> gPointLights;
+	LightClusters gLightClusters;
+
+	// Shadows of the sun, which shines from gLightPosition toward the origin
+	CascadedShadowMap gShadowMap;
 
-	// Light position and scale for the sun above the scene 
+	// Shadows of the point lights, cube faces cached until something moves in them
+	PointShadowMaps gPointShadowMaps;
+
+	// Light color and position for the sun above the scene 
 	glm::vec3 gLightColor(1.0f, 1.0f, 1.0f);
 	glm::vec3 gLightPosition(10.5f, 20.0f, 20.0f);
-	glm::vec3 gLightScale(1.0f, 1.0f, 1.0f);
 
 	//sidewalk lights, these will change when the user presses [ ]  keys to set as orange to replicate fire 
+	//the lights themselves are placed by the light lines of the scene file
 	glm::vec3 gKeyLightColor(0.0f, 0.0f, 0.0f);
-	//each are set for a diffrent lamp
-	glm::vec3 gKeyLightPosition1(22.5f, 6.0f, -20.0f);
-	glm::vec3 gKeyLightPosition2(22.5f, 6.0f, 20.0f);
-	glm::vec3 gKeyLightPosition3(47.5f, 6.0f, -20.0f);
-	glm::vec3 gKeyLightPosition4(47.5f, 6.0f, 20.0f);
-	glm::vec3 gKeyLightScale(1.0f, 1.0f, 1.0f);
 }
 
 
@@ -112,62 +306,192 @@ namespace
 bool UInitialize(int, char* [], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
+void USimulate(float deltaTime);
+void UAcquireSimulationState();
+void URecordInputLatency();
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
-bool UCreateTexture(const char* filename, GLuint& textureId);
+void UPickObject(GLFWwindow* window);
+void URenderCrosshair();
+bool UCreateTexture(const char* const* filenames, int count, GLuint& textureId);
 void UDestroyTexture(GLuint textureId);
 void URender();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+void URenderDeferredLighting();
+void UPrepareViews(const glm::mat4& view, const glm::mat4& projection);
+void URecordView(FrameView& frameView);
+void URecordShadowCasters(FrameView& frameView, GLuint program, GLint drawIdOffsetLocation, const ShadowPassConstants& constants);
+void URecordCamera(FrameView& frameView);
+void URecordRange(RenderCommandList& commands, GLenum target, GLuint binding, const FrameRingRange& range);
+void URenderShadows();
+void URenderPointShadows();
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, ShaderProgram& program);
+void UResolveUniforms();
 void UDestroyShaderProgram(GLuint programId);
 
 
 /*Vertex Shader Source Code*/
-const GLchar* vertexShaderSource = GLSL(440,
+const GLchar* vertexShaderSource = GLSL(460,
 
 	layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
 layout(location = 1) in vec3 normal; // VAP position 1 for normals
 layout(location = 2) in vec2 textureCoordinate;
 
+// computed exactly like the depth pre-pass, so shading lands on the depth it laid down
+invariant gl_Position;
+
+// Per-instance data, see SceneInstanceData and SceneDrawData in scene.h
+struct InstanceData
+{
+	mat4 model;
+	mat3 normalMatrix; // inverse transpose of the model matrix, computed on the CPU
+	vec2 uvScale;
+	uint textureLayer; // material in the texture array
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+};
+struct DrawData
+{
+	vec3 positionOffset; // dequantizes the mesh's vertex positions
+	uint firstInstance; // first entry of the draw in visibleInstances
+	vec3 positionScale;
+};
+layout(std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+layout(std430, binding = 2) readonly buffer VisibleBuffer
+{
+	uint visibleInstances[]; // instances that passed frustum culling
+};
+
 out vec3 vertexNormal; // For outgoing normals to fragment shader
 out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
 out vec2 vertexTextureCoordinate;
+flat out uint vertexTextureLayer;
+out float vertexViewDepth; // For picking the light cluster of the fragment
 
-//Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Camera and lighting values written once per frame, see FrameConstants
+layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams;
+};
+
+uniform uint drawIdOffset; // first command of the current multi-draw call
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+	DrawData draw = draws[drawIdOffset + gl_DrawID];
+	InstanceData instance = instances[visibleInstances[draw.firstInstance + gl_InstanceID]];
+	mat4 model = instance.model;
+	vec3 modelPosition = draw.positionOffset + draw.positionScale * position;
 
-	vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+	gl_Position = projection * view * model * vec4(modelPosition, 1.0f); // Transforms vertices into clip coordinates
 
-	vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
-	vertexTextureCoordinate = textureCoordinate;
+	vertexFragmentPos = vec3(model * vec4(modelPosition, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+
+	vertexNormal = instance.normalMatrix * normal; // get normal vectors in world space only and exclude normal translation properties
+	vertexTextureCoordinate = textureCoordinate * instance.uvScale;
+	vertexTextureLayer = instance.textureLayer;
+	vertexViewDepth = -(view * vec4(vertexFragmentPos, 1.0f)).z;
 }
 );
 
 
 /*Fragment Shader Source Code*/
-const GLchar* fragmentShaderSource = GLSL(440,
+const GLchar* fragmentShaderSource = GLSL(460,
 
 	in vec3 vertexNormal; // For incoming normals
 in vec3 vertexFragmentPos; // For incoming fragment position
 in vec2 vertexTextureCoordinate;
+flat in uint vertexTextureLayer;
+in float vertexViewDepth;
 
 out vec4 fragmentColor; // For outgoing cube color to the GPU
 
-// Uniform / Global variables for object color, light color, light position, and camera/view position
+// Camera and lighting values written once per frame, see FrameConstants
+layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams;
+};
+
+// Point lights and the lights of each cluster, see lightclusters.h
+struct PointLight
+{
+	vec3 position;
+	float radius;
+	vec3 color;
+	int shadowSlot; // cube of uPointShadowMaps, -1 when the light casts no shadow
+};
+layout(std430, binding = 3) readonly buffer LightBuffer
+{
+	PointLight lights[];
+};
+layout(std430, binding = 4) readonly buffer ClusterBuffer
+{
+	uvec2 clusters[]; // offset and count of the cluster in lightIndices
+};
+layout(std430, binding = 5) readonly buffer LightIndexBuffer
+{
+	uint lightIndices[];
+};
+
+// Cube shadows of the point lights, see PointShadowMaps
+uniform samplerCubeArrayShadow uPointShadowMaps;
+
+// 1 where the lamp reaches the surface, 0 in the shadow of an object; the
+// cube faces hold the distance to the light over its radius
+float LampShadow(PointLight pointLight, vec3 position, vec3 normal)
+{
+	// pushed off the surface by a texel and a half of the 256 texel faces, texels grow with distance
+	vec3 fromLight = position - pointLight.position;
+	fromLight += normal * length(fromLight) * (3.0 / 256.0);
+	return texture(uPointShadowMaps, vec4(fromLight, float(pointLight.shadowSlot)), length(fromLight) / pointLight.radius);
+}
+
+// Cascades of the sun shadow, see ShadowConstants
+layout(std140, binding = 1) uniform ShadowConstants
+{
+	mat4 cascadeViewProjection[4];
+	vec4 cascadeSplits;
+	vec4 cascadeTexelSizes;
+};
+uniform sampler2DArrayShadow uShadowMap;
+
+// 1 where the sun reaches the surface, 0 in its shadow
+float SunShadow(vec3 position, vec3 normal, float viewDepth)
+{
+	int cascade = 0;
+	while (cascade < 3 && viewDepth > cascadeSplits[cascade])
+		++cascade;
+
+	// pushed off the surface by a texel and a half against shadow acne
+	vec4 lightClip = cascadeViewProjection[cascade] * vec4(position + normal * cascadeTexelSizes[cascade] * 1.5, 1.0);
+	vec3 coord = lightClip.xyz * 0.5 + 0.5;
+	return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+
+// Uniform / Global variables for object color
 uniform vec3 objectColor;
-uniform vec3 lightColor;
-uniform vec3 keyLightColor;
-uniform vec3 lightPos;
-uniform vec3 keyLightPos;
-uniform vec3 viewPosition;
-uniform sampler2D uTexture; // Useful when working with multiple textures
-uniform vec2 uvScale;
+uniform sampler2DArray uTexture; // every material, one per layer
 
 void main()
 {
@@ -181,18 +505,14 @@ void main()
 	//float ambientStrength = 0.1f; // Set ambient or global lighting strength
 	//vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
 	vec3 light = lightStrength * lightColor;
-	vec3 keyLight = keyLightStrength * keyLightColor;
 
 	//Calculate Diffuse lighting*/
 	vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
 	vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-	vec3 keyLightDirection = normalize(keyLightPos - vertexFragmentPos);
 
 	float impact = max(dot(norm, lightDirection), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-	float keyImpact = max(dot(norm, keyLightDirection), 0.0);
 
 	vec3 diffuse = impact * lightColor; // Generate diffuse light color
-	vec3 keyDiffuse = keyImpact * keyLightColor;
 
 	//Calculate Specular lighting*/
 	float specularIntensity = 0.4f; // Set specular light strength
@@ -203,34 +523,104 @@ void main()
 	float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
 
 	vec3 specular = specularIntensity * specularComponent * lightColor;
-	vec3 keySpecular = specularIntensity * specularComponent * keyLightColor;
+
+	//the sun's direct light is blocked by the objects between it and the fragment
+	float shadow = SunShadow(vertexFragmentPos, norm, vertexViewDepth);
+
+	//Lamps: only the lights assigned to the cluster of this fragment are evaluated
+	uvec3 cell = uvec3(gl_FragCoord.xy / clusterParams.xy * vec2(clusterGrid.xy), max(log(vertexViewDepth) * clusterParams.z + clusterParams.w, 0.0));
+	cell = min(cell, clusterGrid.xyz - uvec3(1u));
+	uvec2 cluster = clusters[cell.x + clusterGrid.x * (cell.y + clusterGrid.y * cell.z)];
+
+	vec3 keyLight = vec3(0.0f);
+	for (uint i = 0u; i < cluster.y; ++i)
+	{
+		PointLight pointLight = lights[lightIndices[cluster.x + i]];
+		vec3 toLight = pointLight.position - vertexFragmentPos;
+
+		// fades smoothly to nothing at the radius of the light
+		float distanceRatio = length(toLight) / pointLight.radius;
+		float attenuation = clamp(1.0f - distanceRatio * distanceRatio, 0.0f, 1.0f);
+		vec3 keyColor = pointLight.color * keyLightColor * attenuation * attenuation;
+
+		vec3 keyLightDirection = normalize(toLight);
+		float keyImpact = max(dot(norm, keyLightDirection), 0.0);
+		float keySpecularComponent = pow(max(dot(viewDir, reflect(-keyLightDirection, norm)), 0.0), highlightSize);
+		float keyShadow = pointLight.shadowSlot >= 0 ? LampShadow(pointLight, vertexFragmentPos, norm) : 1.0;
+		keyLight += (keyLightStrength + keyShadow * (keyImpact + specularIntensity * keySpecularComponent)) * keyColor;
+	}
+
 	// Texture holds the color to be used for all three components
-	vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
-	vec3 phong = (light + keyLight + diffuse + keyDiffuse + specular + keySpecular /*+ objectColor*/) * textureColor.xyz;
+	vec4 textureColor = texture(uTexture, vec3(vertexTextureCoordinate, float(vertexTextureLayer)));
+	vec3 phong = (light + shadow * (diffuse + specular) + keyLight /*+ objectColor*/) * textureColor.xyz;
 	fragmentColor = vec4(phong, 1.0); // Send lighting results to GPU
 }
 );
 
 
 /* Lamp Shader Source Code*/
-const GLchar* lampVertexShaderSource = GLSL(440,
+const GLchar* lampVertexShaderSource = GLSL(460,
 
 	layout(location = 0) in vec3 position; // VAP position 0 for vertex position data
 
-	//Uniform / Global variables for the  transform matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// computed exactly like the depth pre-pass
+invariant gl_Position;
+
+// Per-instance data, see SceneInstanceData and SceneDrawData in scene.h
+struct InstanceData
+{
+	mat4 model;
+	mat3 normalMatrix; // inverse transpose of the model matrix, computed on the CPU
+	vec2 uvScale;
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+};
+struct DrawData
+{
+	vec3 positionOffset; // dequantizes the mesh's vertex positions
+	uint firstInstance; // first entry of the draw in visibleInstances
+	vec3 positionScale;
+};
+layout(std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+layout(std430, binding = 2) readonly buffer VisibleBuffer
+{
+	uint visibleInstances[]; // instances that passed frustum culling
+};
+
+// Camera and lighting values written once per frame, see FrameConstants
+layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams;
+};
+
+uniform uint drawIdOffset; // first command of the current multi-draw call
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(position, 1.0f); // Transforms vertices into clip coordinates
+	DrawData draw = draws[drawIdOffset + gl_DrawID];
+	mat4 model = instances[visibleInstances[draw.firstInstance + gl_InstanceID]].model;
+	vec3 modelPosition = draw.positionOffset + draw.positionScale * position;
+
+	gl_Position = projection * view * model * vec4(modelPosition, 1.0f); // Transforms vertices into clip coordinates
 }
 );
 
 
 /* Fragment Shader Source Code*/
-const GLchar* lampFragmentShaderSource = GLSL(440,
+const GLchar* lampFragmentShaderSource = GLSL(460,
 
 	out vec4 fragmentColor; // For outgoing lamp color (smaller cube) to the GPU
 
@@ -241,6 +631,492 @@ void main()
 );
 
 
+/* Depth Pre-Pass Vertex Shader Source Code, drawn with shadowFragmentShaderSource*/
+const GLchar* depthPrepassVertexShaderSource = GLSL(460,
+
+	layout(location = 0) in vec3 position;
+
+// same expression as vertexShaderSource and lampVertexShaderSource
+invariant gl_Position;
+
+// Per-instance data, see SceneInstanceData and SceneDrawData in scene.h
+struct InstanceData
+{
+	mat4 model;
+	mat3 normalMatrix;
+	vec2 uvScale;
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+};
+struct DrawData
+{
+	vec3 positionOffset; // dequantizes the mesh's vertex positions
+	uint firstInstance; // first entry of the draw in visibleInstances
+	vec3 positionScale;
+};
+layout(std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+layout(std430, binding = 2) readonly buffer VisibleBuffer
+{
+	uint visibleInstances[];
+};
+
+// Camera and lighting values written once per frame, see FrameConstants
+layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams;
+};
+
+uniform uint drawIdOffset;
+
+void main()
+{
+	DrawData draw = draws[drawIdOffset + gl_DrawID];
+	mat4 model = instances[visibleInstances[draw.firstInstance + gl_InstanceID]].model;
+	vec3 modelPosition = draw.positionOffset + draw.positionScale * position;
+	gl_Position = projection * view * model * vec4(modelPosition, 1.0f);
+}
+);
+
+
+/* Deferred Geometry Pass Fragment Shader Source Code, drawn with vertexShaderSource*/
+const GLchar* gBufferFragmentShaderSource = GLSL(460,
+
+	in vec3 vertexNormal; // For incoming normals
+in vec2 vertexTextureCoordinate;
+flat in uint vertexTextureLayer;
+
+layout(location = 0) out vec4 gAlbedo; // texture color, alpha 1 for lit surfaces
+layout(location = 1) out vec2 gNormal; // octahedral encoded world normal
+
+uniform sampler2DArray uTexture;
+
+// Fold the unit sphere onto the [-1, 1] square
+vec2 EncodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return n.xy;
+}
+
+void main()
+{
+	gAlbedo = vec4(texture(uTexture, vec3(vertexTextureCoordinate, float(vertexTextureLayer))).rgb, 1.0);
+	gNormal = EncodeNormal(normalize(vertexNormal));
+}
+);
+
+
+/* Deferred Geometry Pass Lamp Fragment Shader Source Code, drawn with lampVertexShaderSource*/
+const GLchar* lampGBufferFragmentShaderSource = GLSL(460,
+
+	layout(location = 0) out vec4 gAlbedo;
+layout(location = 1) out vec2 gNormal;
+
+void main()
+{
+	gAlbedo = vec4(1.0, 1.0, 1.0, 0.0); // white and unlit, like lampFragmentShaderSource
+	gNormal = vec2(0.0);
+}
+);
+
+
+/* Fullscreen Triangle Vertex Shader Source Code*/
+const GLchar* fullscreenVertexShaderSource = GLSL(460,
+
+	void main()
+{
+	// one triangle covering the screen, built from the vertex index without any vertex buffer
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+);
+
+
+/* Crosshair Vertex Shader Source Code, drawn with lampFragmentShaderSource*/
+const GLchar* crosshairVertexShaderSource = GLSL(460,
+
+	// Camera and lighting values written once per frame, see FrameConstants
+	layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams; // framebuffer width and height, then the depth slice scale and bias
+};
+
+uniform float crosshairSize; // in pixels
+
+void main()
+{
+	// two lines through the center built from the vertex index: 0-1 across, 2-3 up
+	float side = (gl_VertexID & 1) == 0 ? -1.0 : 1.0;
+	vec2 end = gl_VertexID < 2 ? vec2(side, 0.0) : vec2(0.0, side);
+	gl_Position = vec4(end * crosshairSize * 2.0 / clusterParams.xy, 0.0, 1.0);
+}
+);
+
+
+/* Deferred Sun Fragment Shader Source Code*/
+const GLchar* deferredSunFragmentShaderSource = GLSL(460,
+
+	out vec4 fragmentColor;
+
+// Camera and lighting values written once per frame, see FrameConstants
+layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams;
+};
+
+// Cascades of the sun shadow, see ShadowConstants
+layout(std140, binding = 1) uniform ShadowConstants
+{
+	mat4 cascadeViewProjection[4];
+	vec4 cascadeSplits;
+	vec4 cascadeTexelSizes;
+};
+uniform sampler2DArrayShadow uShadowMap;
+
+// 1 where the sun reaches the surface, 0 in its shadow
+float SunShadow(vec3 position, vec3 normal, float viewDepth)
+{
+	int cascade = 0;
+	while (cascade < 3 && viewDepth > cascadeSplits[cascade])
+		++cascade;
+
+	// pushed off the surface by a texel and a half against shadow acne
+	vec4 lightClip = cascadeViewProjection[cascade] * vec4(position + normal * cascadeTexelSizes[cascade] * 1.5, 1.0);
+	vec3 coord = lightClip.xyz * 0.5 + 0.5;
+	return texture(uShadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+vec3 DecodeNormal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float fold = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -fold : fold;
+	n.y += n.y >= 0.0 ? -fold : fold;
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+
+	// unlit surfaces and the background (cleared to 0) keep their color
+	if (albedo.a < 0.5)
+	{
+		fragmentColor = vec4(albedo.rgb, 1.0);
+		return;
+	}
+
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	vec4 world = inverseViewProjection * vec4(gl_FragCoord.xy / clusterParams.xy * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec3 fragmentPos = world.xyz / world.w;
+	vec3 norm = DecodeNormal(texelFetch(gNormal, pixel, 0).xy);
+
+	// same Phong terms as fragmentShaderSource for the light above the scene
+	float lightStrength = 1.0f;
+	vec3 light = lightStrength * lightColor;
+	vec3 lightDirection = normalize(lightPos - fragmentPos);
+	float impact = max(dot(norm, lightDirection), 0.0);
+	vec3 diffuse = impact * lightColor;
+
+	float specularIntensity = 0.4f;
+	float highlightSize = 16.0f;
+	vec3 viewDir = normalize(viewPosition - fragmentPos);
+	vec3 reflectDir = reflect(-lightDirection, norm);
+	float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
+	vec3 specular = specularIntensity * specularComponent * lightColor;
+
+	float shadow = SunShadow(fragmentPos, norm, -(view * vec4(fragmentPos, 1.0)).z);
+
+	fragmentColor = vec4((light + shadow * (diffuse + specular)) * albedo.rgb, 1.0);
+}
+);
+
+
+/* Deferred Point Light Vertex Shader Source Code*/
+const GLchar* deferredLightVertexShaderSource = GLSL(460,
+
+	// Screen rectangle of every light, see LightClusters::lightRects
+	layout(std430, binding = 6) readonly buffer LightRectBuffer
+{
+	vec4 lightRects[]; // normalized device xy min and max
+};
+
+flat out uint lightIndex;
+
+void main()
+{
+	// one instance per light, drawn as a strip of 4 vertices
+	vec4 rect = lightRects[gl_InstanceID];
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	gl_Position = vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);
+	lightIndex = uint(gl_InstanceID);
+}
+);
+
+
+/* Deferred Point Light Fragment Shader Source Code, added on top of the sun pass*/
+const GLchar* deferredLightFragmentShaderSource = GLSL(460,
+
+	flat in uint lightIndex;
+
+out vec4 fragmentColor;
+
+// Camera and lighting values written once per frame, see FrameConstants
+layout(std140, binding = 0) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 inverseViewProjection;
+	vec3 viewPosition;
+	vec3 lightColor;
+	vec3 lightPos;
+	vec3 keyLightColor;
+	uvec4 clusterGrid;
+	vec4 clusterParams;
+};
+
+// Point lights, see lightclusters.h
+struct PointLight
+{
+	vec3 position;
+	float radius;
+	vec3 color;
+	int shadowSlot; // cube of uPointShadowMaps, -1 when the light casts no shadow
+};
+layout(std430, binding = 3) readonly buffer LightBuffer
+{
+	PointLight lights[];
+};
+
+// Cube shadows of the point lights, see PointShadowMaps
+uniform samplerCubeArrayShadow uPointShadowMaps;
+
+// 1 where the lamp reaches the surface, 0 in the shadow of an object; the
+// cube faces hold the distance to the light over its radius
+float LampShadow(PointLight pointLight, vec3 position, vec3 normal)
+{
+	// pushed off the surface by a texel and a half of the 256 texel faces, texels grow with distance
+	vec3 fromLight = position - pointLight.position;
+	fromLight += normal * length(fromLight) * (3.0 / 256.0);
+	return texture(uPointShadowMaps, vec4(fromLight, float(pointLight.shadowSlot)), length(fromLight) / pointLight.radius);
+}
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+
+vec3 DecodeNormal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float fold = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -fold : fold;
+	n.y += n.y >= 0.0 ? -fold : fold;
+	return normalize(n);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+	if (albedo.a < 0.5)
+		discard;
+
+	float depth = texelFetch(gDepth, pixel, 0).r;
+	vec4 world = inverseViewProjection * vec4(gl_FragCoord.xy / clusterParams.xy * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec3 fragmentPos = world.xyz / world.w;
+
+	PointLight pointLight = lights[lightIndex];
+	vec3 toLight = pointLight.position - fragmentPos;
+
+	// the rectangle bounds the sphere of the light, pixels beyond its radius get nothing
+	float distanceRatio = length(toLight) / pointLight.radius;
+	if (distanceRatio >= 1.0)
+		discard;
+
+	// same terms as the lamp loop of fragmentShaderSource
+	float keyLightStrength = 0.5f;
+	float specularIntensity = 0.4f;
+	float highlightSize = 16.0f;
+	vec3 norm = DecodeNormal(texelFetch(gNormal, pixel, 0).xy);
+	vec3 viewDir = normalize(viewPosition - fragmentPos);
+
+	float attenuation = 1.0f - distanceRatio * distanceRatio;
+	vec3 keyColor = pointLight.color * keyLightColor * attenuation * attenuation;
+
+	vec3 keyLightDirection = normalize(toLight);
+	float keyImpact = max(dot(norm, keyLightDirection), 0.0);
+	float keySpecularComponent = pow(max(dot(viewDir, reflect(-keyLightDirection, norm)), 0.0), highlightSize);
+	float keyShadow = pointLight.shadowSlot >= 0 ? LampShadow(pointLight, fragmentPos, norm) : 1.0;
+	fragmentColor = vec4((keyLightStrength + keyShadow * (keyImpact + specularIntensity * keySpecularComponent)) * keyColor * albedo.rgb, 1.0);
+}
+);
+
+
+/* Shadow Cascade Vertex Shader Source Code*/
+const GLchar* shadowVertexShaderSource = GLSL(460,
+
+	layout(location = 0) in vec3 position;
+
+// Per-instance data, see SceneInstanceData and SceneDrawData in scene.h
+struct InstanceData
+{
+	mat4 model;
+	mat3 normalMatrix;
+	vec2 uvScale;
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+};
+struct DrawData
+{
+	vec3 positionOffset; // dequantizes the mesh's vertex positions
+	uint firstInstance; // first entry of the draw in visibleInstances
+	vec3 positionScale;
+};
+layout(std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+layout(std430, binding = 2) readonly buffer VisibleBuffer
+{
+	uint visibleInstances[]; // instances inside the cascade
+};
+
+// Light view of the cascade being drawn, see ShadowPassConstants
+layout(std140, binding = 2) uniform ShadowPassConstants
+{
+	mat4 lightViewProjection;
+	vec4 lightSphere;
+};
+uniform uint drawIdOffset;
+
+void main()
+{
+	DrawData draw = draws[drawIdOffset + gl_DrawID];
+	mat4 model = instances[visibleInstances[draw.firstInstance + gl_InstanceID]].model;
+	vec3 modelPosition = draw.positionOffset + draw.positionScale * position;
+	gl_Position = lightViewProjection * model * vec4(modelPosition, 1.0f);
+}
+);
+
+
+/* Shadow Cascade Fragment Shader Source Code, only depth is written*/
+const GLchar* shadowFragmentShaderSource = GLSL(460,
+
+	void main()
+{
+}
+);
+
+
+/* Point Shadow Vertex Shader Source Code*/
+const GLchar* pointShadowVertexShaderSource = GLSL(460,
+
+	layout(location = 0) in vec3 position;
+
+// Per-instance data, see SceneInstanceData and SceneDrawData in scene.h
+struct InstanceData
+{
+	mat4 model;
+	mat3 normalMatrix;
+	vec2 uvScale;
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer
+{
+	InstanceData instances[];
+};
+struct DrawData
+{
+	vec3 positionOffset; // dequantizes the mesh's vertex positions
+	uint firstInstance; // first entry of the draw in visibleInstances
+	vec3 positionScale;
+};
+layout(std430, binding = 1) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+layout(std430, binding = 2) readonly buffer VisibleBuffer
+{
+	uint visibleInstances[]; // instances inside the cube face
+};
+
+// Light view of the cube face being drawn, see ShadowPassConstants
+layout(std140, binding = 2) uniform ShadowPassConstants
+{
+	mat4 lightViewProjection;
+	vec4 lightSphere; // position and radius of the light
+};
+uniform uint drawIdOffset;
+
+out vec3 worldPosition;
+
+void main()
+{
+	DrawData draw = draws[drawIdOffset + gl_DrawID];
+	mat4 model = instances[visibleInstances[draw.firstInstance + gl_InstanceID]].model;
+	vec3 modelPosition = draw.positionOffset + draw.positionScale * position;
+	vec4 world = model * vec4(modelPosition, 1.0f);
+	worldPosition = world.xyz;
+	gl_Position = lightViewProjection * world;
+}
+);
+
+
+/* Point Shadow Fragment Shader Source Code*/
+const GLchar* pointShadowFragmentShaderSource = GLSL(460,
+
+	in vec3 worldPosition;
+
+layout(std140, binding = 2) uniform ShadowPassConstants
+{
+	mat4 lightViewProjection;
+	vec4 lightSphere;
+};
+
+void main()
+{
+	// distance instead of perspective depth, so the lookup does not depend on the face
+	gl_FragDepth = length(worldPosition - lightSphere.xyz) / lightSphere.w;
+}
+);
+
+
 // Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
 void flipImageVertically(unsigned char* image, int width, int height, int channels)
 {
@@ -261,153 +1137,216 @@ void flipImageVertically(unsigned char* image, int width, int height, int channe
 }
 
 
+// One axis of resampleImage: the average of the covered texels when shrinking,
+// linear interpolation when growing; both wrap around like GL_REPEAT
+void resampleAxis(const float* source, int sourceSize, int sourceStride, float* destination, int destinationSize, int destinationStride)
+{
+	float scale = (float)sourceSize / destinationSize;
+	for (int d = 0; d < destinationSize; ++d)
+	{
+		float value = 0.0f;
+		if (scale > 1.0f)
+		{
+			float begin = d * scale;
+			float end = begin + scale;
+			for (int i = (int)begin; i < end; ++i)
+			{
+				float coverage = std::min(end, i + 1.0f) - std::max(begin, (float)i);
+				value += source[(i % sourceSize) * sourceStride] * coverage;
+			}
+			value /= scale;
+		}
+		else
+		{
+			float position = (d + 0.5f) * scale - 0.5f;
+			int i = (int)std::floor(position);
+			float t = position - i;
+			value = source[((i + sourceSize) % sourceSize) * sourceStride] * (1.0f - t) + source[((i + 1) % sourceSize) * sourceStride] * t;
+		}
+		destination[d * destinationStride] = value;
+	}
+}
+
+// Resample an RGBA image to a square of size texels, one axis after the other
+void resampleImage(const unsigned char* image, int width, int height, unsigned char* resampled, int size)
+{
+	std::vector<float> source(image, image + width * height * 4);
+	std::vector<float> rows(size * height * 4);
+	std::vector<float> result(size * size * 4);
+
+	for (int y = 0; y < height; ++y)
+		for (int c = 0; c < 4; ++c)
+			resampleAxis(&source[y * width * 4 + c], width, 4, &rows[y * size * 4 + c], size, 4);
+
+	for (int x = 0; x < size; ++x)
+		for (int c = 0; c < 4; ++c)
+			resampleAxis(&rows[x * 4 + c], height, size * 4, &result[x * 4 + c], size, size * 4);
+
+	for (int i = 0; i < size * size * 4; ++i)
+		resampled[i] = (unsigned char)std::min(std::max(result[i] + 0.5f, 0.0f), 255.0f);
+}
+
+
 int main(int argc, char* argv[])
 {
 	if (!UInitialize(argc, argv, &gWindow))
 		return EXIT_FAILURE;
-
-	// Create the mesh
-	//UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
-	meshes.CreateMeshes();
-
-	// Create the shader program
-	if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
+
+	// Create the mesh
+	//UCreateMesh(gMesh); // Calls the function to create the Vertex Buffer Object
+	meshes.CreateMeshes(MESH_VERTEX_FORMAT);
+
+	// Create the shader program
+	if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(vertexShaderSource, gBufferFragmentShaderSource, gGBufferProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(lampVertexShaderSource, lampGBufferFragmentShaderSource, gLampGBufferProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(fullscreenVertexShaderSource, deferredSunFragmentShaderSource, gDeferredSunProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(deferredLightVertexShaderSource, deferredLightFragmentShaderSource, gDeferredLightProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(depthPrepassVertexShaderSource, shadowFragmentShaderSource, gDepthPrepassProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(shadowVertexShaderSource, shadowFragmentShaderSource, gShadowProgram))
+		return EXIT_FAILURE;
+	if (!UCreateShaderProgram(pointShadowVertexShaderSource, pointShadowFragmentShaderSource, gPointShadowProgram))
 		return EXIT_FAILURE;
-	if (!UCreateShaderProgram(lampVertexShaderSource, lampFragmentShaderSource, gLampProgramId))
+	if (!UCreateShaderProgram(crosshairVertexShaderSource, lampFragmentShaderSource, gCrosshairProgram))
 		return EXIT_FAILURE;
+	UResolveUniforms();
 
 
 	// Load textures
 	// 
-	//grass texture
-	const char* texFilename = "C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/4.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdGrass))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
+	// every material of the scene is a layer of one texture array, so the lit objects
+	// never switch textures; the names match the texture column of the scene file
+	const char* const materialNames[] = { "grass", "sidewalk", "lampbase", "lamplight", "pot", "dirt", "bark", "leaves", "stem", "brick" };
+	const char* const materialFilenames[] = {
+		"C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/4.jpg",
+		"C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/images.jpg",
+		"C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/lamp post.png",
+		"C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/lamp light.png",
+		"C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/teracota.jpg",
+		"C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/dirt.jpg",
+		"C:/Users/erica/Downloads/Project1(5-5) (2)(1)/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/tree bark.jpg",
+		"C:/Users/erica/Downloads/Project1(5-5) (2)(1)/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/leaves.jpg",
+		"C:/Users/erica/Downloads/Project1(5-5) (2)(1)/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/stem.jpg",
+		"C:/Users/erica/Downloads/Project1(7-1)/Project1/Project1/brick(seemless).jpg"
+	};
+	const int materialCount = sizeof(materialFilenames) / sizeof(materialFilenames[0]);
+	if (!UCreateTexture(materialFilenames, materialCount, gTextureIdMaterials))
 		return EXIT_FAILURE;
-	}
 
-	//sidwalk texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/images.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdSidewalk))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
-		return EXIT_FAILURE;
-	}
 
-	//lamp base texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/lamp post.png";
-	if (!UCreateTexture(texFilename, gTextureIdLampBase))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
+	// Load the scene description
+	std::vector<SceneTexture> sceneTextures;
+	for (int i = 0; i < materialCount; ++i)
+		sceneTextures.push_back({ materialNames[i], gTextureIdMaterials, (GLuint)i });
+	if (!gScene.LoadScene(SCENE_FILENAME, meshes, sceneTextures))
 		return EXIT_FAILURE;
-	}
-
-	//lamp light texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/lamp light.png";
-	if (!UCreateTexture(texFilename, gTextureIdLampLight))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
+	gScene.CreateDrawBuffers();
+
+	// Size the frame ring for the most a frame writes: the camera slices, every cascade and the
+	// budgeted cube faces each cull the scene, plus the light lists and the constants
+	const int shadowPassesPerFrame = SHADOW_CASCADE_COUNT + PointShadowMaps::FACE_BUDGET;
+	gScene.ReserveCullRanges(gFrameRing, CAMERA_SLICE_COUNT + shadowPassesPerFrame);
+	gLightClusters.ReserveRanges(gFrameRing, gScene.lights.size());
+	gFrameRing.Reserve(sizeof(FrameConstants));
+	gFrameRing.Reserve(sizeof(ShadowConstants));
+	gFrameRing.Reserve(sizeof(ShadowPassConstants), shadowPassesPerFrame);
+	if (!gFrameRing.Create())
 		return EXIT_FAILURE;
-	}
 
-	//plant pot texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/teracota.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdPot))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
-		return EXIT_FAILURE;
-	}
+	// Views are culled and recorded on every core, the main thread included
+	gFrameViews.resize(CAMERA_SLICE_COUNT + shadowPassesPerFrame);
+	gWorkerPool.Create(std::max(0, (int)std::thread::hardware_concurrency() - 1));
 
-	//dirt texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/dirt.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdDirt))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
-		return EXIT_FAILURE;
-	}
 
-	//tree bark texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5) (2)(1)/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/tree bark.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdBark))
+	// tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
+	glUseProgram(gProgram.id);
+	glUniform1i(gLitUniforms.uTexture, MATERIAL_ARRAY_UNIT);
+	glUniform1i(gLitUniforms.uShadowMap, SHADOW_MAP_UNIT);
+	glUniform1i(gLitUniforms.uPointShadowMaps, POINT_SHADOW_MAP_UNIT);
+	glUseProgram(gGBufferProgram.id);
+	glUniform1i(gGBufferUniforms.uTexture, MATERIAL_ARRAY_UNIT);
+
+	// the crosshair never changes size
+	glUseProgram(gCrosshairProgram.id);
+	glUniform1f(gCrosshairUniforms.crosshairSize, CROSSHAIR_SIZE);
+
+	// the deferred lighting passes read the G-buffer targets
+	const DeferredUniforms* deferredUniforms[] = { &gDeferredSunUniforms, &gDeferredLightUniforms };
+	const GLuint deferredPrograms[] = { gDeferredSunProgram.id, gDeferredLightProgram.id };
+	for (int i = 0; i < 2; ++i)
 	{
-		cout << "Failed to load texture " << texFilename << endl;
-		return EXIT_FAILURE;
+		glUseProgram(deferredPrograms[i]);
+		glUniform1i(deferredUniforms[i]->gAlbedo, GBUFFER_ALBEDO_UNIT);
+		glUniform1i(deferredUniforms[i]->gNormal, GBUFFER_NORMAL_UNIT);
+		glUniform1i(deferredUniforms[i]->gDepth, GBUFFER_DEPTH_UNIT);
+		glUniform1i(deferredUniforms[i]->uShadowMap, SHADOW_MAP_UNIT);
+		glUniform1i(deferredUniforms[i]->uPointShadowMaps, POINT_SHADOW_MAP_UNIT);
 	}
 
-	//tree leaves texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5) (2)(1)/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/leaves.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdLeaves))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
-		return EXIT_FAILURE;
-	}
+	// core profile draws need a VAO bound even without attributes
+	glGenVertexArrays(1, &gFullscreenVao);
 
-	//tree leaves texture 
-	texFilename = "C:/Users/erica/Downloads/Project1(5-5) (2)(1)/Project1(5-5)/Project1(5-5)/Project1(1)/Project1/Project1/stem.jpg";
-	if (!UCreateTexture(texFilename, gTextureIdStem))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
+	if (!gShadowMap.Create())
 		return EXIT_FAILURE;
-	}
-
-	//Brick texture  
-	texFilename = "C:/Users/erica/Downloads/Project1(7-1)/Project1/Project1/brick(seemless).jpg";
-	if (!UCreateTexture(texFilename, gTextureIdBrick))
-	{
-		cout << "Failed to load texture " << texFilename << endl;
+	if (!gPointShadowMaps.Create())
 		return EXIT_FAILURE;
-	}
-
-
-	// tell opengl for each sampler to which texture unit it belongs to (only has to be done once)
-	glUseProgram(gProgramId);
-	// We set the texture as texture unit 0
-	glUniform1i(glGetUniformLocation(gProgramId, "uTexture"), 0);
+	gOverdrawCounters.Create();
 
 	// Sets the background color of the window to black (it will be implicitely used by glClear)
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
+	// The renderer draws the initial state until the first step is published
+	gSimulationStates.Publish(gSimulationState);
+	gSimulation.Start(SIMULATION_STEP, USimulate);
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(gWindow))
 	{
-
-		// per-frame timing
-		// --------------------
-		float currentFrame = glfwGetTime();
-		gDeltaTime = currentFrame - gLastFrame;
-		gLastFrame = currentFrame;
-
-		// input
+		// input, handed to the simulation thread
 		// -----
+		glfwPollEvents();
 		UProcessInput(gWindow);
 
-		// Render this frame
+		// Render this frame from the newest simulation state
 		URender();
-
-		glfwPollEvents();
 	}
 
+	gSimulation.Stop();
+	gWorkerPool.Destroy();
+
 	// Release mesh data
+	gScene.DestroyDrawBuffers();
+	gGBuffer.Destroy();
+	glDeleteVertexArrays(1, &gFullscreenVao);
+	gShadowMap.Destroy();
+	gPointShadowMaps.Destroy();
+	gOverdrawCounters.Destroy();
+	gFrameRing.Destroy();
 	meshes.DestroyMeshes();
 
 	// Release texture
-	UDestroyTexture(gTextureIdGrass);
-	UDestroyTexture(gTextureIdSidewalk);
-	UDestroyTexture(gTextureIdLampBase);
-	UDestroyTexture(gTextureIdLampLight);
-	UDestroyTexture(gTextureIdPot);
-	UDestroyTexture(gTextureIdDirt);
-	UDestroyTexture(gTextureIdBark);
-	UDestroyTexture(gTextureIdLeaves);
-	UDestroyTexture(gTextureIdStem);
-	UDestroyTexture(gTextureIdBrick);
-	UDestroyTexture(gTextureId);
+	UDestroyTexture(gTextureIdMaterials);
 
 	// Release shader program
-	UDestroyShaderProgram(gProgramId);
-	UDestroyShaderProgram(gLampProgramId);
+	UDestroyShaderProgram(gProgram.id);
+	UDestroyShaderProgram(gLampProgram.id);
+	UDestroyShaderProgram(gGBufferProgram.id);
+	UDestroyShaderProgram(gLampGBufferProgram.id);
+	UDestroyShaderProgram(gDeferredSunProgram.id);
+	UDestroyShaderProgram(gDeferredLightProgram.id);
+	UDestroyShaderProgram(gDepthPrepassProgram.id);
+	UDestroyShaderProgram(gShadowProgram.id);
+	UDestroyShaderProgram(gPointShadowProgram.id);
+	UDestroyShaderProgram(gCrosshairProgram.id);
 
 	exit(EXIT_SUCCESS); // Terminates the program successfully
 }
@@ -420,7 +1359,7 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 	// ------------------------------
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
@@ -437,6 +1376,7 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 		return false;
 	}
 	glfwMakeContextCurrent(*window);
+	glfwGetFramebufferSize(*window, &gFramebufferWidth, &gFramebufferHeight);
 	glfwSetFramebufferSizeCallback(*window, UResizeWindow);
 	glfwSetCursorPosCallback(*window, UMousePositionCallback);
 	glfwSetScrollCallback(*window, UMouseScrollCallback);
@@ -464,66 +1404,172 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 }
 
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// process all input: query GLFW whether relevant keys are pressed/released this frame and hand them to the simulation
 void UProcessInput(GLFWwindow* window)
 {
-	glm::mat4 projection;
-	static const float cameraSpeed = 2.5f;
-
 	//exit the scene 
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
 
+	//print the overdraw of the shading pass once per key press
+	static bool infoKeyDown = false;
+	bool infoKey = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+	if (infoKey && !infoKeyDown)
+	{
+		cout << "Overdraw " << gOverdrawCounters.overdraw << ": " << gOverdrawCounters.fragmentsShaded << " fragments shaded, "
+			<< gOverdrawCounters.samplesPassed << " passed depth, " << gOverdrawCounters.pixels << " pixels, depth pre-pass "
+			<< (gDepthPrepass ? "on" : "off") << endl;
+		cout << "State changes last frame: " << gStateCache.nLastIssued << " issued, " << gStateCache.nLastSaved << " skipped as redundant" << endl;
+		cout << "Frame ring: " << gFrameRing.nStalls << " stalls on the GPU, " << gFrameRing.stallMilliseconds << " ms waited, last frame "
+			<< gFrameRing.lastStallMilliseconds << " ms; peak " << gFrameRing.peakUsed << " of " << gFrameRing.regionSize << " bytes per frame, "
+			<< gFrameRing.nOverflows << " ranges refused, " << gFrameRing.nDroppedViews << " views dropped" << endl;
+		cout << "Command packets last frame: " << gCommandQueue.nExecuted << " from " << gFrameViewCount << " views recorded on "
+			<< gWorkerPool.ThreadCount() << " threads" << endl;
+		cout << "Light clusters: at most " << gLightClusters.maxClusterLights << " of " << LightClusters::MAX_CLUSTER_LIGHTS << " lights per cluster, "
+			<< gLightClusters.nDroppedLightIndices << " cluster entries dropped last frame" << endl;
+		cout << "Input to present: last " << gInputLatency.lastMilliseconds << " ms, average " << gInputLatency.averageMilliseconds
+			<< " ms, max " << gInputLatency.maxMilliseconds << " ms over " << gInputLatency.nSamples << " inputs; "
+			<< gSimulation.nSteps << " simulation steps at " << 1.0 / SIMULATION_STEP << " Hz, " << gSimulation.nDroppedSteps << " dropped" << endl;
+	}
+	infoKeyDown = infoKey;
+
+	//the keys that steer the scene go to the simulation thread, which applies them at its next step
+	bool changed = gMouseInput;
+	gMouseInput = false;
+	{
+		lock_guard<mutex> lock(gInputMutex);
+		for (int key : SIMULATION_KEYS)
+		{
+			bool down = glfwGetKey(window, key) == GLFW_PRESS;
+			changed = changed || down != gInput.keys[key];
+			gInput.keys[key] = down;
+		}
+		if (changed)
+			++gInput.sequence;
+	}
+
+	// time the new input until a frame that reflects it is presented
+	if (changed)
+		gPendingInputs.push_back({ gInput.sequence, glfwGetTime() });
+}
+
+
+// One fixed step of the simulation thread: apply the input polled since the last step and publish the new state
+void USimulate(float deltaTime)
+{
+	SimulationInput input;
+	{
+		lock_guard<mutex> lock(gInputMutex);
+		input = gInput;
+		gInput.mouseX = 0.0f;
+		gInput.mouseY = 0.0f;
+		gInput.scroll = 0.0f;
+	}
+
+	SimulationState& state = gSimulationState;
+	state.inputSequence = input.sequence;
+
 	//move around the scene 
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(FORWARD, gDeltaTime);
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(BACKWARD, gDeltaTime);
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(LEFT, gDeltaTime);
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(RIGHT, gDeltaTime);
-	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(UP, gDeltaTime);
-	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-		gCamera.ProcessKeyboard(DOWN, gDeltaTime);
+	if (input.keys[GLFW_KEY_W])
+		state.camera.ProcessKeyboard(FORWARD, deltaTime);
+	if (input.keys[GLFW_KEY_S])
+		state.camera.ProcessKeyboard(BACKWARD, deltaTime);
+	if (input.keys[GLFW_KEY_A])
+		state.camera.ProcessKeyboard(LEFT, deltaTime);
+	if (input.keys[GLFW_KEY_D])
+		state.camera.ProcessKeyboard(RIGHT, deltaTime);
+	if (input.keys[GLFW_KEY_Q])
+		state.camera.ProcessKeyboard(UP, deltaTime);
+	if (input.keys[GLFW_KEY_E])
+		state.camera.ProcessKeyboard(DOWN, deltaTime);
+
+	//look around and change the camera speed
+	if (input.mouseX != 0.0f || input.mouseY != 0.0f)
+		state.camera.ProcessMouseMovement(input.mouseX, input.mouseY);
+	if (input.scroll != 0.0f)
+		state.camera.ProcessMouseScroll(input.scroll);
 
 	//change the ortho view 
-	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS)
-		perspective = false;
-	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
-		perspective = true;
+	if (input.keys[GLFW_KEY_O])
+		state.perspective = false;
+	if (input.keys[GLFW_KEY_P])
+		state.perspective = true;
 
 	//change the shapes to wireframe 
-	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	if (input.keys[GLFW_KEY_RIGHT])
+		state.polygonMode = GL_LINE;
 	// fill shapes
-	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	if (input.keys[GLFW_KEY_LEFT])
+		state.polygonMode = GL_FILL;
+
+	//switch between forward and deferred shading
+	if (input.keys[GLFW_KEY_F] && state.deferred)
+	{
+		cout << "Switching to forward shading" << endl;
+		state.deferred = false;
+	}
+	if (input.keys[GLFW_KEY_G] && !state.deferred)
+	{
+		cout << "Switching to deferred shading" << endl;
+		state.deferred = true;
+	}
+
+	//lay down depth before shading, or shade directly
+	if (input.keys[GLFW_KEY_Z] && !state.depthPrepass)
+	{
+		cout << "Depth pre-pass on" << endl;
+		state.depthPrepass = true;
+	}
+	if (input.keys[GLFW_KEY_X] && state.depthPrepass)
+	{
+		cout << "Depth pre-pass off" << endl;
+		state.depthPrepass = false;
+	}
 
 	//turn on/off the sun and lamps
-	if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)
+	if (input.keys[GLFW_KEY_LEFT_BRACKET] && state.lightColor != glm::vec3(0.0f))
 	{
 		cout << "Turning off the main light /sun" << endl;
-		gKeyLightColor.r = 1.0f;
-		gKeyLightColor.g = 0.6f;
-		gKeyLightColor.b = 0.0f;
-
-		gLightColor.r = 0.0f;
-		gLightColor.g = 0.0f;
-		gLightColor.b = 0.0f;
+		state.keyLightColor = glm::vec3(1.0f, 0.6f, 0.0f);
+		state.lightColor = glm::vec3(0.0f, 0.0f, 0.0f);
 	}
 
-	if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+	if (input.keys[GLFW_KEY_RIGHT_BRACKET] && state.lightColor != glm::vec3(1.0f))
 	{
 		cout << "Turning on the sun and off the lamps" << endl;
-		gKeyLightColor.r = 0.0f;
-		gKeyLightColor.g = 0.0f;
-		gKeyLightColor.b = 0.0f;
+		state.keyLightColor = glm::vec3(0.0f, 0.0f, 0.0f);
+		state.lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
+	}
+
+	gSimulationStates.Publish(state);
+}
+
+
+// Copy the newest simulation state into the values the frame draws with; the simulation goes on with the next steps meanwhile
+void UAcquireSimulationState()
+{
+	SimulationState state;
+	gSimulationStates.Acquire(state);
+
+	gCamera = state.camera;
+	perspective = state.perspective;
+	gPolygonMode = state.polygonMode;
+	gDeferred = state.deferred && gDeferredAvailable;
+	gDepthPrepass = state.depthPrepass;
+	gLightColor = state.lightColor;
+	gKeyLightColor = state.keyLightColor;
+	gRenderStateSequence = state.inputSequence;
+}
+
 
-		gLightColor.r = 1.0f;
-		gLightColor.g = 1.0f;
-		gLightColor.b = 1.0f;
+// The frame just presented shows every input its state had seen; record how long each took to get there
+void URecordInputLatency()
+{
+	double presentTime = glfwGetTime();
+	while (!gPendingInputs.empty() && gPendingInputs.front().sequence <= gRenderStateSequence)
+	{
+		gInputLatency.Add((presentTime - gPendingInputs.front().time) * 1000.0);
+		gPendingInputs.pop_front();
 	}
 }
 
@@ -531,6 +1577,8 @@ void UProcessInput(GLFWwindow* window)
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 void UResizeWindow(GLFWwindow* window, int width, int height)
 {
+	gFramebufferWidth = width;
+	gFramebufferHeight = height;
 	glViewport(0, 0, width, height);
 }
 
@@ -552,7 +1600,10 @@ void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
 	gLastX = xpos;
 	gLastY = ypos;
 
-	gCamera.ProcessMouseMovement(xoffset, yoffset);
+	lock_guard<mutex> lock(gInputMutex);
+	gInput.mouseX += xoffset;
+	gInput.mouseY += yoffset;
+	gMouseInput = true;
 }
 
 
@@ -560,8 +1611,10 @@ void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos)
 // ----------------------------------------------------------------------
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
-	// change camera speed by mouse scroll
-	gCamera.ProcessMouseScroll(yoffset);
+	// change camera speed by mouse scroll, at the next simulation step
+	lock_guard<mutex> lock(gInputMutex);
+	gInput.scroll += (float)yoffset;
+	gMouseInput = true;
 }
 
 
@@ -574,7 +1627,10 @@ void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 	case GLFW_MOUSE_BUTTON_LEFT:
 	{
 		if (action == GLFW_PRESS)
+		{
 			cout << "Left mouse button pressed" << endl;
+			UPickObject(window);
+		}
 		else
 			cout << "Left mouse button released" << endl;
 	}
@@ -605,1398 +1661,524 @@ void UMouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 }
 
 
-// Functioned called to render a frame
-void URender()
+// Cast a ray from the camera through the cursor, or the crosshair while mouse look hides it, and report the scene object it hits first
+void UPickObject(GLFWwindow* window)
 {
-	glm::mat4 scale;
-	glm::mat4 rotation;
-	glm::mat4 translation;
-	glm::mat4 model;
-	glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-	glm::mat4 view = gCamera.GetViewMatrix();
-	GLint modelLoc;
-	GLint viewLoc;
-	GLint projLoc;
-	GLint objectColorLoc;
-
-	// Enable z-depth
-	glEnable(GL_DEPTH_TEST);
-
-	// Clear the frame and z buffers
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	glBindVertexArray(gMesh.vao);
-
-	// Transforms the camera
-	view = gCamera.GetViewMatrix();
-
-	// Creates a orthographic projection
-	if (!perspective) {
-		projection = glm::perspective(glm::radians(60.0f), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
-
+	// a disabled cursor moves without bounds and is not where the user looks, the crosshair at the center is
+	float x = 0.0f;
+	float y = 0.0f;
+	if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED)
+	{
+		double xpos, ypos;
+		int width, height;
+		glfwGetCursorPos(window, &xpos, &ypos);
+		glfwGetWindowSize(window, &width, &height);
+
+		// cursor to normalized device coordinates, window y goes down but NDC y goes up
+		x = 2.0f * (float)xpos / (float)width - 1.0f;
+		y = 1.0f - 2.0f * (float)ypos / (float)height;
 	}
-	else
-		projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 100.0f);
-
-
-	// Set the shader to be used
-	glUseProgram(gProgramId);
-
-	// Retrieves and passes transform matrices to the Shader program
-	modelLoc = glGetUniformLocation(gProgramId, "model");
-	viewLoc = glGetUniformLocation(gProgramId, "view");
-	projLoc = glGetUniformLocation(gProgramId, "projection");
-	objectColorLoc = glGetUniformLocation(gProgramId, "uObjectColor");
-
-	GLint lightColorLoc = glGetUniformLocation(gProgramId, "lightColor");
-	GLint lightPositionLoc = glGetUniformLocation(gProgramId, "lightPos");
-
-	GLint keyLightColorLoc = glGetUniformLocation(gProgramId, "keyLightColor");
-	GLint keyLightPositionLoc = glGetUniformLocation(gProgramId, "keyLightPos");
-
-	GLint viewPositionLoc = glGetUniformLocation(gProgramId, "viewPosition");
-
-	glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-	glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-	glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-
-	glUniform3f(keyLightColorLoc, gKeyLightColor.r, gKeyLightColor.g, gKeyLightColor.b);
-	glUniform3f(keyLightPositionLoc, gKeyLightPosition1.x, gKeyLightPosition1.y, gKeyLightPosition1.z);
-	glUniform3f(keyLightPositionLoc, gKeyLightPosition2.x, gKeyLightPosition2.y, gKeyLightPosition2.z);
-	glUniform3f(keyLightPositionLoc, gKeyLightPosition3.x, gKeyLightPosition3.y, gKeyLightPosition3.z);
-	glUniform3f(keyLightPositionLoc, gKeyLightPosition4.x, gKeyLightPosition4.y, gKeyLightPosition4.z);
-
-
-	const glm::vec3 cameraPosition = gCamera.Position;
-	glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-
-	GLint UVScaleLoc = glGetUniformLocation(gProgramId, "uvScale");
-	glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-
-	//Grass mesh perameters
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gPlaneMesh.vao);
-
-	// bind textures on corresponding texture units
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdGrass);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(50.0f, 0.0f, 40.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(0.0f, 0.0f, 0.0f));
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 0.0f, 0.0f);
-
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gPlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-
-	//Sidewalk mesh perameters
-	glBindVertexArray(meshes.gPlaneMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdSidewalk);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(10.0f, 0.0f, 40.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(35.0f, 0.01f, 0.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 0.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gPlaneMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
 
+	// unproject the cursor on the near and far planes with the matrices of the last frame
+	glm::mat4 inverseViewProjection = glm::inverse(gFrameConstants.projection * gFrameConstants.view);
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
 
-	//Garden Light 1 mesh perameters
+	auto start = chrono::high_resolution_clock::now();
+	float distance;
+	int picked = gScene.PickInstance(origin, direction, distance);
+	chrono::duration<double, micro> elapsed = chrono::high_resolution_clock::now() - start;
 
-	//Cylinder bottom post going into the ground 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.5f, 4.0f, 0.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 0.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder top cylinder for the light texture 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampLight);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 2.5f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 6.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cyclinder bottom cylinder to create the curve of the lamp
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 5.0f, 20.0f));
-	// Model matrix: transformations are applied right-to-left order
-
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cyclinder top tappered the meets the bottom cylinder to the lamp its self 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 1.0f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 6.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// Torus top of lamp to give it depth 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.84f, 1.84f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(4.7f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 8.5f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-
-	//Garden Light 2
-
-	//Cylinder bottom post going into the ground 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.5f, 4.0f, 0.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 0.0f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder top cylinder for the light texture
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampLight);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 2.5f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 6.0f, -20.0f));
-	// Model matrix: transformations are applied right-to-left order
-
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cylinder bottom cylinder to create the curve of the lamp
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 5.0f, -20.0f));
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cyclinder cylinder top tapered the meets the bottom cylinder to the lamp its self
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 1.0f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 6.0f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// Torus top of lamp to give it depth
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.84f, 1.84f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(4.7f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(47.5f, 8.5f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-
-	//Garden Light 3
-
-	//Cylinder bottom post going into the ground 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.5f, 4.0f, 0.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 0.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder top cylinder for the light texture
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampLight);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 2.5f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 6.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cylinder bottom cylinder to create the curve of the lamp
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 5.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cylinder top tapered the meets the bottom cylinder to the lamp its self
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 1.0f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 6.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// Torus top of lamp to give it depth
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.84f, 1.84f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(4.7f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 8.5f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-
-	//Garden Light 4
-
-	//Cylinder bottom post going into the ground 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.5f, 4.0f, 0.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 0.0f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder top cylinder for the light texture
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampLight);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 2.5f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 6.0f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cylinder bottom cylinder to create the curve of the lamp
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.0f, 1.0f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 5.0f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// tapered cylinder top tapered the meets the bottom cylinder to the lamp its self
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.0f, 1.0f, 2.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 6.0f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// Torus top of lamp to give it depth
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLampBase);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.84f, 1.84f, 1.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(4.7f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(22.5f, 8.5f, -20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-
-	//Plant 1
-
-	// tapered cyclinder main part of the pot 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdPot);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(3.0f, 5.0f, 3.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 5.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// Torus the rim of the pot 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdPot);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.84f, 2.84f, 5.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(4.7f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 5.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder the stem of the plant 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdDirt);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(2.7f, 0.01f, 2.7f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 5.0f, 20.0f));
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//The leaves of the plant 
-	//Cylinder 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdStem);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.2f, 3.0f, 0.2f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 5.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.4f, 0.01f, 0.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.8f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(3.5f, 8.9f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.4f, 0.01f, 0.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(-0.8f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(1.5f, 8.9f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.4f, 0.01f, 1.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(-0.8f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 8.9f, 21.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.4f, 0.01f, 1.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.8f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 8.9f, 19.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.4f, 0.01f, 1.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(-0.8f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 6.9f, 21.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.4f, 0.01f, 1.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.8f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 7.9f, 19.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.4f, 0.01f, 0.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(-0.8f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(1.5f, 7.45f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Sphere to add more depth to the plant its place at the top of the stem 
-
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gSphereMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(0.15f, 0.15f, 0.15f));
-	// 2. Rotate the object
-	rotation = glm::rotate(-0.4f, glm::vec3(0.0, 1.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(2.5f, 8.0f, 20.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 0.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gSphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-
-	//Plant 2
-
-	// tapered cyclinder main part of the pot 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTaperedCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdPot);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.5f, 2.5f, 1.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(3.14f, glm::vec3(0.0, 0.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(5.5f, 2.5f, 15.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	// Torus the rim of the pot 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gTorusMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdPot);
-
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.4f, 1.4f, 3.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(4.7f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(5.5f, 2.5f, 15.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLES, 0, meshes.gTorusMesh.nVertices);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//Cylinder the dirt of the pot  
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdDirt);
+	if (picked < 0)
+	{
+		cout << "Nothing picked (" << elapsed.count() << " us)" << endl;
+		return;
+	}
 
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.4f, 0.01f, 1.4f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(5.5f, 2.5f, 15.0f));
+	const SceneInstance& instance = gScene.instances[picked];
+	glm::vec3 position(gScene.nodes[instance.node].world[3]);
+	cout << "Picked " << SceneMeshName(instance.mesh) << " from " << SCENE_FILENAME << ":" << instance.sourceLine
+		<< " at (" << position.x << ", " << position.y << ", " << position.z << ") in " << elapsed.count() << " us" << endl;
+}
 
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
 
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
+// Functioned called to render a frame
+void URender()
+{
+	glm::mat4 projection;
+	glm::mat4 view;
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+	// The simulation thread prepares the next state while this frame is drawn
+	UAcquireSimulationState();
 
+	// Wait for the GPU only if it still reads the ring region written FrameRing::FRAME_COUNT frames ago
+	gFrameRing.BeginFrame();
 
+	// The deferred path draws the objects into the G-buffer, sized like the window
+	if (gDeferred && (gGBuffer.width != gFramebufferWidth || gGBuffer.height != gFramebufferHeight))
+	{
+		gGBuffer.Destroy();
+		if (gFramebufferWidth > 0 && gFramebufferHeight > 0 && !gGBuffer.Create(gFramebufferWidth, gFramebufferHeight))
+		{
+			cout << "Deferred shading unavailable, switching to forward shading" << endl;
+			gDeferred = false;
+			gDeferredAvailable = false;
+		}
 
-	// large tree
+		// creating the targets bound them behind the cache's back
+		gStateCache.Invalidate();
+	}
 
-	//Cylinder trunk of the bush 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gCylinderMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdBark);
+	// Transforms the camera
+	view = gCamera.GetViewMatrix();
 
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(1.25f, 10.0f, 1.25f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.3f, glm::vec3(1.0, 0.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(-10.5f, -0.5f, -23.0f));
+	// Creates a orthographic projection
+	if (!perspective) {
+		projection = glm::perspective(glm::radians(60.0f), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
 
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 1.0f, 1.0f, 0.0f, 1.0f);
+	}
+	else
+		projection = glm::ortho(-5.0f, 5.0f, -5.0f, 5.0f, NEAR_PLANE, FAR_PLANE);
 
-	// Draws the triangles
-	glDrawArrays(GL_TRIANGLE_FAN, 0, 36);		//bottom
-	glDrawArrays(GL_TRIANGLE_FAN, 36, 36);		//top
-	glDrawArrays(GL_TRIANGLE_STRIP, 72, 146);	//sides
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+	// Upload the per-instance model matrices of the objects that moved
+	gScene.UpdateInstanceBuffer();
 
+	// The lights follow their lamps
+	gScene.GatherLights(gPointLights);
 
-	//Sphere the leaves of the bush, put at a sqew due to the tree has a odd shape for I wanted to keep the realism 
+	// The out of date shadow cascades and cube faces and the camera are the views of the frame
+	UPrepareViews(view, projection);
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gSphereMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdLeaves);
+	// Workers cull every view and record its draws as packets, one more job sorts the lights into the clusters of the camera
+	gWorkerPool.Run(gFrameViewCount + 1, [&](int job)
+		{
+			if (job < gFrameViewCount)
+				URecordView(gFrameViews[job]);
+			else
+				gLightClusters.AssignLights(gFrameRing, gPointLights, view, projection, NEAR_PLANE, FAR_PLANE);
+		});
+
+	// Back on the thread owning the context, the packets are executed in sort key order, pass by pass
+	std::vector<const RenderCommandList*> commandLists;
+	for (int i = 0; i < gFrameViewCount; ++i)
+		commandLists.push_back(&gFrameViews[i].commands);
+	gCommandQueue.Merge(commandLists);
+
+	gScene.BindDrawBuffers(gFrameRing);
+	gLightClusters.BindBuffers(gFrameRing);
+
+	// Shadows are drawn first, so the camera passes can sample them
+	URenderShadows();
+	URenderPointShadows();
+
+
+	// Write the camera and lighting values once for every program
+	gFrameConstants.view = view;
+	gFrameConstants.projection = projection;
+	gFrameConstants.inverseViewProjection = glm::inverse(projection * view);
+	gFrameConstants.viewPosition = gCamera.Position;
+	gFrameConstants.lightColor = gLightColor;
+	gFrameConstants.lightPos = gLightPosition;
+	gFrameConstants.keyLightColor = gKeyLightColor;
+	gFrameConstants.clusterGrid = glm::uvec4(LightClusters::GRID_X, LightClusters::GRID_Y, LightClusters::GRID_Z, 0);
+	gFrameConstants.clusterParams = glm::vec4((float)gFramebufferWidth, (float)gFramebufferHeight,
+		gLightClusters.depthScale, gLightClusters.depthBias);
+
+	gFrameRing.BindRange(GL_UNIFORM_BUFFER, FRAME_CONSTANTS_BINDING, gFrameRing.Write(&gFrameConstants, sizeof(FrameConstants)));
 
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(15.0f, 9.0f, 24.0f));
-	// 2. Rotate the object
-	rotation = glm::rotate(-0.4f, glm::vec3(0.0, 1.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(-10.5f, 13.5f, -18.0f));
+	// Enable z-depth
+	glEnable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, gPolygonMode);
 
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 1.0f, 0.0f, 1.0f);
+	// Clear the frame and z buffers; an alpha of 0 marks the G-buffer background as unlit
+	gStateCache.BindFramebuffer(gDeferred ? gGBuffer.fbo : 0);
+	glClearColor(0.0f, 0.0f, 0.0f, gDeferred ? 0.0f : 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gSphereMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+	gShadowMap.BindTexture(gStateCache);
+	gPointShadowMaps.BindTexture(gStateCache);
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+	// Activate the shared VBOs of every mesh, no other VAO is needed for the frame
+	gStateCache.BindVertexArray(meshes.vao);
 
+	// The camera slices are the last views and share their passes; the first is the depth pre-pass, the second the shading
+	const FrameView& camera = gFrameViews[gFrameViewCount - 1];
 
+	// The pre-pass writes only depth, so the shading pass runs once per pixel for the nearest surface
+	if (gDepthPrepass)
+	{
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		gCommandQueue.ExecutePass(camera.pass, gStateCache);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-	//Brick lining the front yard, going from porch toward the tree
+		// the depth is final, shading only has to match it
+		glDepthFunc(GL_LEQUAL);
+		glDepthMask(GL_FALSE);
+	}
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdBrick);
+	gOverdrawCounters.Begin(gFramebufferWidth, gFramebufferHeight);
+	gCommandQueue.ExecutePass(camera.pass + 1, gStateCache);
+	gOverdrawCounters.End();
 
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(35.5f, 1.0f, 1.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(1.57f, glm::vec3(0.0, 1.0f, 0.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(-30.5f, -0.25f, 20.0f));
+	if (gDepthPrepass)
+	{
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
 
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.5f, 0.5f, 0.0f, 1.0f);
+	if (gDeferred)
+		URenderDeferredLighting();
 
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+	// picking goes through the center while mouse look has the cursor
+	if (glfwGetInputMode(gWindow, GLFW_CURSOR) == GLFW_CURSOR_DISABLED)
+		URenderCrosshair();
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+	gStateCache.EndFrame();
+	gFrameRing.EndFrame();
 
 
+	// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+	glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+	URecordInputLatency();
+}
 
-	//Brick lining the front yard, going from left to right
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, gTextureIdBrick);
+// Decide which shadow cascades and cube faces have to be drawn; each becomes a view of the frame, followed by the camera slices
+void UPrepareViews(const glm::mat4& view, const glm::mat4& projection)
+{
+	gFrameViewCount = 0;
+	auto addView = [](const glm::mat4& viewProjection, int cascade, int face, int pass, int slice, int bvhRoot)
+	{
+		FrameView& frameView = gFrameViews[gFrameViewCount];
+		frameView.viewProjection = viewProjection;
+		frameView.cascade = cascade;
+		frameView.face = face;
+		frameView.pass = pass;
+		frameView.slice = slice;
+		frameView.bvhRoot = bvhRoot;
+		++gFrameViewCount;
+	};
 
-	// 1. Scales the object
-	scale = glm::scale(glm::vec3(47.5f, 1.0f, 1.5f));
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-	// 3. Position the object
-	translation = glm::translate(glm::vec3(-6.0f, -0.25f, 3.0f));
+	if (!gScene.bvh.nodes.empty())
+	{
+		// the root of the BVH bounds every caster
+		const BvhNode& root = gScene.bvh.nodes[0];
+		gShadowMap.Update(gFrameRing, view, projection, NEAR_PLANE, FAR_PLANE, glm::normalize(gLightPosition), root.boundsMin, root.boundsMax,
+			gScene.instancesMoved, gScene.movedBoundsMin, gScene.movedBoundsMax);
+		for (int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+		{
+			if (gShadowMap.cascades[i].stale)
+				addView(gShadowMap.cascades[i].viewProjection, i, -1, 2 * gFrameViewCount, 0, 0);
+		}
 
-	// Model matrix: transformations are applied right-to-left order
-	model = translation * rotation * scale;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+		gPointShadowMaps.Update(gPointLights, gScene.lights, gCamera.Position, ExtractFrustum(projection * view),
+			gScene.instancesMoved, gScene.movedBoundsMin, gScene.movedBoundsMax);
+		for (std::size_t i = 0; i < gPointShadowMaps.faceUpdates.size(); ++i)
+			addView(gPointShadowMaps.faceUpdates[i].viewProjection, -1, (int)i, 2 * gFrameViewCount, 0, 0);
+	}
 
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.5f, 0.5f, 0.0f, 1.0f);
+	// one slice per thread that can record it; the slices draw into the same two passes
+	int sliceCount = std::min(CAMERA_SLICE_COUNT, gWorkerPool.ThreadCount() + 1);
+	gScene.bvh.SplitSubtrees(sliceCount, gCameraSliceRoots);
+	gCameraSliceCount = (int)gCameraSliceRoots.size();
 
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+	int cameraPass = 2 * gFrameViewCount;
+	for (int i = 0; i < gCameraSliceCount; ++i)
+		addView(projection * view, -1, -1, cameraPass, i, gCameraSliceRoots[i]);
+}
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+// Cull the scene for one view and record its passes; runs on a worker thread, so it calls no GL
+void URecordView(FrameView& frameView)
+{
+	bool isCamera = frameView.cascade < 0 && frameView.face < 0;
 
+	// nearest first for the camera, so early depth testing discards what later draws would hide
+	frameView.commands.Clear();
+	gScene.CullInstances(gFrameRing, frameView.viewProjection, frameView.scene, isCamera, frameView.bvhRoot);
 
-	//
-	//
-	//LIGHT SOURCES 
-	//
-	//
+	// the indirect offsets and bindings of a view whose lists the full ring refused would read
+	// another view's data, so it draws nothing this frame
+	const SceneView& scene = frameView.scene;
+	if (!scene.visibleRange.data || !scene.drawDataRange.data || !scene.commandRange.data)
+	{
+		gFrameRing.DropView();
+		return;
+	}
 
+	if (frameView.cascade >= 0)
+	{
+		ShadowPassConstants constants = { frameView.viewProjection, glm::vec4(0.0f) };
+		URecordShadowCasters(frameView, gShadowProgram.id, gShadowUniforms.drawIdOffset, constants);
+	}
+	else if (frameView.face >= 0)
+	{
+		const PointShadowFace& face = gPointShadowMaps.faceUpdates[frameView.face];
+		ShadowPassConstants constants = { face.viewProjection, glm::vec4(face.lightPosition, face.lightRadius) };
+		URecordShadowCasters(frameView, gPointShadowProgram.id, gPointShadowUniforms.drawIdOffset, constants);
+	}
+	else
+		URecordCamera(frameView);
+}
 
-	// normal white light
+// Record the draws of the shadow casters into a cascade or cube face with the given depth program
+void URecordShadowCasters(FrameView& frameView, GLuint program, GLint drawIdOffsetLocation, const ShadowPassConstants& constants)
+{
+	FrameRingRange constantsRange = gFrameRing.Write(&constants, sizeof(constants));
+	if (!constantsRange.data)
+	{
+		gFrameRing.DropView();
+		return;
+	}
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glUseProgram(gLampProgramId);
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
+	RenderCommandList& commands = frameView.commands;
+	commands.SetSlot(frameView.pass, 0);
+	commands.UseProgram(program);
+	URecordRange(commands, GL_UNIFORM_BUFFER, SHADOW_PASS_CONSTANTS_BINDING, constantsRange);
+	URecordRange(commands, GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, frameView.scene.drawDataRange);
+	URecordRange(commands, GL_SHADER_STORAGE_BUFFER, VISIBLE_BUFFER_BINDING, frameView.scene.visibleRange);
 
-	// Model matrix: transformations are applied right-to-left order
-	model = glm::translate(gLightPosition) * glm::scale(gLightScale) * rotation;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 0.0f, 0.0f);
-	modelLoc = glGetUniformLocation(gLampProgramId, "model");
-	viewLoc = glGetUniformLocation(gLampProgramId, "view");
-	projLoc = glGetUniformLocation(gLampProgramId, "projection");
+	// lamps are light sources, they do not cast shadows
+	for (std::size_t i = 0; i < gScene.drawGroups.size(); ++i)
+	{
+		const SceneDrawGroup& group = gScene.drawGroups[i];
+		if (group.program != SCENE_PROGRAM_LIT)
+			continue;
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+		commands.SetSlot(frameView.pass, (GLuint)i + 1);
+		commands.SetUniform(drawIdOffsetLocation, group.firstCommand);
+		commands.Draw(group.mode, gScene.IndirectOffset(frameView.scene, group), group.commandCount);
+	}
+}
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+// Record the depth pre-pass of a camera slice, when it is on, and its shading pass
+void URecordCamera(FrameView& frameView)
+{
+	RenderCommandList& commands = frameView.commands;
+	const SceneView& scene = frameView.scene;
+
+	// The i-th group of every slice goes in slot 1 + i * slices + slice, so the merge keeps the groups of
+	// the slices side by side; the lists of a slice are bound again before each of its draws, and groups
+	// with nothing visible in the slice are left out
+	auto slotOf = [&](std::size_t i) { return (GLuint)(1 + i * gCameraSliceCount + frameView.slice); };
+	auto isEmpty = [&](const SceneDrawGroup& group)
+	{
+		for (GLuint command = group.firstCommand; command < group.firstCommand + group.commandCount; ++command)
+		{
+			if (scene.drawCommands[command].instanceCount > 0)
+				return false;
+		}
+		return true;
+	};
 
+	// The deferred geometry pass draws the same groups, only writing surfaces instead of shading them
+	const ShaderProgram& litProgram = gDeferred ? gGBufferProgram : gProgram;
+	const ShaderProgram& lampProgram = gDeferred ? gLampGBufferProgram : gLampProgram;
+	const LitUniforms& litUniforms = gDeferred ? gGBufferUniforms : gLitUniforms;
+	const LampUniforms& lampUniforms = gDeferred ? gLampGBufferUniforms : gLampUniforms;
 
+	if (gDepthPrepass)
+	{
+		commands.SetSlot(frameView.pass, 0);
+		commands.UseProgram(gDepthPrepassProgram.id);
+		for (std::size_t i = 0; i < scene.drawGroupOrder.size(); ++i)
+		{
+			const SceneDrawGroup& group = gScene.drawGroups[scene.drawGroupOrder[i]];
+			if (isEmpty(group))
+				continue;
+
+			commands.SetSlot(frameView.pass, slotOf(i));
+			URecordRange(commands, GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, scene.drawDataRange);
+			URecordRange(commands, GL_SHADER_STORAGE_BUFFER, VISIBLE_BUFFER_BINDING, scene.visibleRange);
+			commands.SetUniform(gDepthPrepassUniforms.drawIdOffset, group.firstCommand);
+			commands.Draw(group.mode, gScene.IndirectOffset(scene, group), group.commandCount);
+		}
+	}
 
-	//key light 1
+	int shadingPass = frameView.pass + 1;
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glUseProgram(gLampProgramId);
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
+	// Once the pre-pass settled depth, draw order no longer changes what is shaded, so the groups
+	// go in the order they were built, sorted by program, vertex array and texture, to switch state least
+	for (std::size_t i = 0; i < gScene.drawGroups.size(); ++i)
+	{
+		const SceneDrawGroup& group = gScene.drawGroups[gDepthPrepass ? i : scene.drawGroupOrder[i]];
+		if (isEmpty(group))
+			continue;
 
-	// Model matrix: transformations are applied right-to-left order
-	model = glm::translate(gKeyLightPosition1) * glm::scale(gKeyLightScale) * rotation;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 0.0f, 0.0f);
-	modelLoc = glGetUniformLocation(gLampProgramId, "model");
-	viewLoc = glGetUniformLocation(gLampProgramId, "view");
-	projLoc = glGetUniformLocation(gLampProgramId, "projection");
+		bool isLamp = group.program == SCENE_PROGRAM_LAMP;
+		commands.SetSlot(shadingPass, slotOf(i));
+		commands.UseProgram(isLamp ? lampProgram.id : litProgram.id);
+		URecordRange(commands, GL_SHADER_STORAGE_BUFFER, DRAW_BUFFER_BINDING, scene.drawDataRange);
+		URecordRange(commands, GL_SHADER_STORAGE_BUFFER, VISIBLE_BUFFER_BINDING, scene.visibleRange);
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+		// bind textures on corresponding texture units
+		if (group.program == SCENE_PROGRAM_LIT)
+			commands.BindTexture(MATERIAL_ARRAY_UNIT, GL_TEXTURE_2D_ARRAY, group.textureId);
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+		// gl_DrawID restarts at 0 for every call, so pass where the group starts
+		commands.SetUniform(isLamp ? lampUniforms.drawIdOffset : litUniforms.drawIdOffset, group.firstCommand);
 
+		// Draws the triangles
+		commands.Draw(group.mode, gScene.IndirectOffset(scene, group), group.commandCount);
+	}
+}
 
-	//key light 2
+// Record the bind of a frame ring range; a range the full ring refused is skipped
+void URecordRange(RenderCommandList& commands, GLenum target, GLuint binding, const FrameRingRange& range)
+{
+	if (range.data)
+		commands.BindRange(target, binding, gFrameRing.buffer, range.offset, range.size);
+}
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glUseProgram(gLampProgramId);
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
+// Execute the recorded cascades; the cascades the camera and moving objects left valid keep last frame's depth
+void URenderShadows()
+{
+	glEnable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
 
-	// Model matrix: transformations are applied right-to-left order
-	model = glm::translate(gKeyLightPosition2) * glm::scale(gKeyLightScale) * rotation;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 0.0f, 0.0f);
-	modelLoc = glGetUniformLocation(gLampProgramId, "model");
-	viewLoc = glGetUniformLocation(gLampProgramId, "view");
-	projLoc = glGetUniformLocation(gLampProgramId, "projection");
+	gStateCache.BindVertexArray(meshes.vao);
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
+	for (int i = 0; i < gFrameViewCount; ++i)
+	{
+		const FrameView& frameView = gFrameViews[i];
+		if (frameView.cascade < 0)
+			continue;
 
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+		gShadowMap.BeginCascade(frameView.cascade, gStateCache);
+		gCommandQueue.ExecutePass(frameView.pass, gStateCache);
+	}
 
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	gStateCache.BindFramebuffer(0);
+	glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
+}
 
-	//key light 3
+// Execute the recorded point shadow faces, no more than the per-frame budget
+void URenderPointShadows()
+{
+	if (gPointShadowMaps.faceUpdates.empty())
+		return;
 
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glUseProgram(gLampProgramId);
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = glm::translate(gKeyLightPosition3) * glm::scale(gKeyLightScale) * rotation;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 0.0f, 0.0f);
-	modelLoc = glGetUniformLocation(gLampProgramId, "model");
-	viewLoc = glGetUniformLocation(gLampProgramId, "view");
-	projLoc = glGetUniformLocation(gLampProgramId, "projection");
-
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
-
-
-	//key light 4
-
-	// Activate the VBOs contained within the mesh's VAO
-	glBindVertexArray(meshes.gBoxMesh.vao);
-	glUseProgram(gLampProgramId);
-	// 2. Rotate the object
-	rotation = glm::rotate(0.0f, glm::vec3(1.0, 1.0f, 1.0f));
-
-	// Model matrix: transformations are applied right-to-left order
-	model = glm::translate(gKeyLightPosition4) * glm::scale(gKeyLightScale) * rotation;
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glProgramUniform4f(gProgramId, objectColorLoc, 0.0f, 0.0f, 0.0f, 0.0f);
-	modelLoc = glGetUniformLocation(gLampProgramId, "model");
-	viewLoc = glGetUniformLocation(gLampProgramId, "view");
-	projLoc = glGetUniformLocation(gLampProgramId, "projection");
+	// the faces store distances written by the fragment shader, which polygon offset does not move
+	glEnable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-	// Pass matrix data to the Lamp Shader program's matrix uniforms
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-	// Draws the triangles
-	glDrawElements(GL_TRIANGLES, meshes.gBoxMesh.nIndices, GL_UNSIGNED_INT, (void*)0);
-
-	// Deactivate the Vertex Array Object
-	glBindVertexArray(0);
+	gStateCache.BindVertexArray(meshes.vao);
 
+	for (int i = 0; i < gFrameViewCount; ++i)
+	{
+		const FrameView& frameView = gFrameViews[i];
+		if (frameView.face < 0)
+			continue;
 
+		gPointShadowMaps.BeginFace(gPointShadowMaps.faceUpdates[frameView.face], gStateCache);
+		gCommandQueue.ExecutePass(frameView.pass, gStateCache);
+	}
 
-	// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-	glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
+	gStateCache.BindFramebuffer(0);
+	glViewport(0, 0, gFramebufferWidth, gFramebufferHeight);
 }
 
+// Draw the crosshair over the finished frame, inverting the pixels under it so it shows on any background
+void URenderCrosshair()
+{
+	gStateCache.BindFramebuffer(0);
+	glDisable(GL_DEPTH_TEST);
+	gStateCache.BindVertexArray(gFullscreenVao);
+	gStateCache.UseProgram(gCrosshairProgram.id);
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE_MINUS_DST_COLOR, GL_ZERO);
+	glDrawArrays(GL_LINES, 0, 4);
+	glDisable(GL_BLEND);
+}
 
+// Shade the G-buffer into the window: the sun once per pixel, then each point light over its screen rectangle
+void URenderDeferredLighting()
+{
+	gStateCache.BindFramebuffer(0);
+	glDisable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	gGBuffer.BindTextures(gStateCache);
+	gStateCache.BindVertexArray(gFullscreenVao);
+
+	// the sun pass writes every pixel, so the window needs no clear
+	gStateCache.UseProgram(gDeferredSunProgram.id);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// lights add up on top of it; rectangles of lights outside the view are empty
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE);
+	gStateCache.UseProgram(gDeferredLightProgram.id);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)gPointLights.size());
+	glDisable(GL_BLEND);
+}
 
-/*Generate and load the texture*/
-bool UCreateTexture(const char* filename, GLuint& textureId)
+/*Generate a texture array with one layer per image, every image resampled to MATERIAL_LAYER_SIZE*/
+bool UCreateTexture(const char* const* filenames, int count, GLuint& textureId)
 {
-	int width, height, channels;
-	unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-	if (image)
+	int levels = 1 + (int)std::log2((float)MATERIAL_LAYER_SIZE);
+
+	glGenTextures(1, &textureId);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, count);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	std::vector<unsigned char> layer(MATERIAL_LAYER_SIZE * MATERIAL_LAYER_SIZE * 4);
+	for (int i = 0; i < count; ++i)
 	{
-		flipImageVertically(image, width, height, channels);
-
-		glGenTextures(1, &textureId);
-		glBindTexture(GL_TEXTURE_2D, textureId);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		if (channels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		else if (channels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+		// stb converts every image to 4 channels, so layers of RGB and RGBA files look alike
+		int width, height, channels;
+		unsigned char* image = stbi_load(filenames[i], &width, &height, &channels, 4);
+		if (!image)
 		{
-			cout << "Not implemented to handle image with " << channels << " channels" << endl;
+			cout << "Failed to load texture " << filenames[i] << endl;
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			glDeleteTextures(1, &textureId);
+			textureId = 0;
 			return false;
 		}
 
-		glGenerateMipmap(GL_TEXTURE_2D);
-
+		flipImageVertically(image, width, height, 4);
+		resampleImage(image, width, height, layer.data(), MATERIAL_LAYER_SIZE);
 		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
-		return true;
+
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
 	}
 
-	// Error loading the image
-	return false;
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return true;
 }
 
 
 void UDestroyTexture(GLuint textureId)
 {
-	glGenTextures(1, &textureId);
+	glDeleteTextures(1, &textureId);
 }
 
 
 // Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, ShaderProgram& program)
 {
 	// Compilation and linkage error reporting
 	int success = 0;
 	char infoLog[512];
 
 	// Create a Shader program object.
-	programId = glCreateProgram();
+	GLuint programId = glCreateProgram();
+	program.id = programId;
 
 	// Create the vertex and fragment shader objects
 	GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
@@ -2046,10 +2228,80 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
 
 	glUseProgram(programId);    // Uses the shader program
 
+	// Record the active uniforms so their locations never have to be looked up while rendering
+	program.Reflect();
+
 	return true;
 }
 
 
+// Resolve the uniform locations of every program once, warning about names that are not active
+void UResolveUniforms()
+{
+	gLitUniforms.drawIdOffset = gProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+	gLitUniforms.uTexture = gProgram.FindUniform("uTexture", GL_SAMPLER_2D_ARRAY);
+	gLitUniforms.uShadowMap = gProgram.FindUniform("uShadowMap", GL_SAMPLER_2D_ARRAY_SHADOW);
+	gLitUniforms.uPointShadowMaps = gProgram.FindUniform("uPointShadowMaps", GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW);
+
+	gLampUniforms.drawIdOffset = gLampProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+
+	gGBufferUniforms.drawIdOffset = gGBufferProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+	gGBufferUniforms.uTexture = gGBufferProgram.FindUniform("uTexture", GL_SAMPLER_2D_ARRAY);
+	gGBufferUniforms.uShadowMap = -1;
+	gGBufferUniforms.uPointShadowMaps = -1;
+
+	gLampGBufferUniforms.drawIdOffset = gLampGBufferProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+
+	gDepthPrepassUniforms.drawIdOffset = gDepthPrepassProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+
+	gDeferredSunUniforms.gAlbedo = gDeferredSunProgram.FindUniform("gAlbedo", GL_SAMPLER_2D);
+	gDeferredSunUniforms.gNormal = gDeferredSunProgram.FindUniform("gNormal", GL_SAMPLER_2D);
+	gDeferredSunUniforms.gDepth = gDeferredSunProgram.FindUniform("gDepth", GL_SAMPLER_2D);
+	gDeferredSunUniforms.uShadowMap = gDeferredSunProgram.FindUniform("uShadowMap", GL_SAMPLER_2D_ARRAY_SHADOW);
+	gDeferredSunUniforms.uPointShadowMaps = -1;
+
+	gDeferredLightUniforms.gAlbedo = gDeferredLightProgram.FindUniform("gAlbedo", GL_SAMPLER_2D);
+	gDeferredLightUniforms.gNormal = gDeferredLightProgram.FindUniform("gNormal", GL_SAMPLER_2D);
+	gDeferredLightUniforms.gDepth = gDeferredLightProgram.FindUniform("gDepth", GL_SAMPLER_2D);
+	gDeferredLightUniforms.uShadowMap = -1;
+	gDeferredLightUniforms.uPointShadowMaps = gDeferredLightProgram.FindUniform("uPointShadowMaps", GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW);
+
+	gShadowUniforms.drawIdOffset = gShadowProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+
+	gPointShadowUniforms.drawIdOffset = gPointShadowProgram.FindUniform("drawIdOffset", GL_UNSIGNED_INT);
+
+	gCrosshairUniforms.crosshairSize = gCrosshairProgram.FindUniform("crosshairSize", GL_FLOAT);
+
+	// Every program must agree with the C++ layout of the shared block
+	const ShaderProgram* programs[] = { &gProgram, &gLampProgram, &gGBufferProgram, &gLampGBufferProgram,
+		&gDeferredSunProgram, &gDeferredLightProgram, &gDepthPrepassProgram, &gCrosshairProgram };
+	for (const ShaderProgram* program : programs)
+	{
+		GLuint blockIndex = program->FindUniformBlock("FrameConstants");
+		if (blockIndex != GL_INVALID_INDEX && program->uniformBlocks[blockIndex].dataSize != (GLint)sizeof(FrameConstants))
+			cout << "WARNING::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH FrameConstants in program " << program->id << endl;
+	}
+
+	// and the programs shading the sun with the layout of the cascades
+	const ShaderProgram* shadowedPrograms[] = { &gProgram, &gDeferredSunProgram };
+	for (const ShaderProgram* program : shadowedPrograms)
+	{
+		GLuint blockIndex = program->FindUniformBlock("ShadowConstants");
+		if (blockIndex != GL_INVALID_INDEX && program->uniformBlocks[blockIndex].dataSize != (GLint)sizeof(ShadowConstants))
+			cout << "WARNING::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH ShadowConstants in program " << program->id << endl;
+	}
+
+	// and the shadow programs with the layout of the light view
+	const ShaderProgram* shadowPrograms[] = { &gShadowProgram, &gPointShadowProgram };
+	for (const ShaderProgram* program : shadowPrograms)
+	{
+		GLuint blockIndex = program->FindUniformBlock("ShadowPassConstants");
+		if (blockIndex != GL_INVALID_INDEX && program->uniformBlocks[blockIndex].dataSize != (GLint)sizeof(ShadowPassConstants))
+			cout << "WARNING::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH ShadowPassConstants in program " << program->id << endl;
+	}
+}
+
+
 void UDestroyShaderProgram(GLuint programId)
 {
 	glDeleteProgram(programId);
@@ -0,0 +1,543 @@
+///////////////////////////////////////////////////////////////////////////////
+// bvh.cpp
+// ========
+// bounding volume hierarchy over bounding spheres, for culling and ray queries
+///////////////////////////////////////////////////////////////////////////////
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace
+{
+	// number of bins the surface area heuristic evaluates per axis
+	const int SAH_BINS = 8;
+	// nodes with this many primitives or fewer become leaves when splitting does not pay off
+	const int MAX_LEAF_SIZE = 8;
+	// a refitted tree this much more expensive than a fresh build is rebuilt
+	const float REBUILD_COST_RATIO = 1.5f;
+
+	const float INFINITE_DISTANCE = std::numeric_limits<float>::infinity();
+
+	///////////////////////////////////////////////////
+	//	HalfArea(const glm::vec3&, const glm::vec3&)
+	//
+	//	Half the surface area of a box, enough to compare SAH costs
+	///////////////////////////////////////////////////
+	float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		glm::vec3 extent = boundsMax - boundsMin;
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+
+	///////////////////////////////////////////////////
+	//	IntersectBox(const glm::vec3&, const glm::vec3&, const BvhNode&)
+	//
+	//	Slab test of a ray against a node's box; return the entry
+	//	distance, or infinity when the ray misses the box
+	///////////////////////////////////////////////////
+	float IntersectBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const BvhNode& node)
+	{
+		float entry = IntersectRayBox(origin, inverseDirection, node.boundsMin, node.boundsMax);
+		return entry >= 0.0f ? entry : INFINITE_DISTANCE;
+	}
+}
+
+///////////////////////////////////////////////////
+//	IntersectRayBox(const glm::vec3&, const glm::vec3&, const glm::vec3&, const glm::vec3&)
+//
+//	Slab test of a ray against a box. A ray parallel to a
+//	slab would multiply 0 by infinity when its origin is on
+//	one of the planes, so those slabs are tested on the
+//	origin alone
+///////////////////////////////////////////////////
+float IntersectRayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	float entry = 0.0f;
+	float exit = INFINITE_DISTANCE;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (std::isinf(inverseDirection[i]))
+		{
+			if (origin[i] < boundsMin[i] || origin[i] > boundsMax[i])
+				return -1.0f;
+			continue;
+		}
+
+		float t0 = (boundsMin[i] - origin[i]) * inverseDirection[i];
+		float t1 = (boundsMax[i] - origin[i]) * inverseDirection[i];
+		entry = std::max(entry, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+	}
+	return entry <= exit ? entry : -1.0f;
+}
+
+///////////////////////////////////////////////////
+//	Build(const float*, const float*, const float*, const float*, std::size_t)
+//
+//	x, y, z, r: bounding sphere of each primitive
+//	count: number of primitives
+//
+//	Build the hierarchy from scratch
+///////////////////////////////////////////////////
+void Bvh::Build(const float* x, const float* y, const float* z, const float* r, std::size_t count)
+{
+	nodes.clear();
+	primitiveIndices.resize(count);
+	for (std::size_t i = 0; i < count; ++i)
+		primitiveIndices[i] = (GLuint)i;
+
+	GatherSpheres(x, y, z, r);
+
+	builtCost = 0.0f;
+	++nBuilds;
+	if (count == 0)
+		return;
+
+	// a binary tree with one primitive per leaf has 2n - 1 nodes
+	nodes.reserve(2 * count);
+
+	BvhNode root;
+	root.left = -1;
+	root.first = 0;
+	root.count = (int)count;
+	UpdateLeafBounds(root);
+	nodes.push_back(root);
+
+	Subdivide(0);
+
+	builtCost = Cost();
+}
+
+///////////////////////////////////////////////////
+//	Refit(const float*, const float*, const float*, const float*)
+//
+//	Update the boxes of the existing tree after the primitives
+//	moved, bottom-up; rebuild when the tree has degraded
+///////////////////////////////////////////////////
+void Bvh::Refit(const float* x, const float* y, const float* z, const float* r)
+{
+	GatherSpheres(x, y, z, r);
+
+	// children are stored after their parent, so a reverse walk visits them first
+	for (int i = (int)nodes.size() - 1; i >= 0; --i)
+	{
+		BvhNode& node = nodes[i];
+		if (node.left < 0)
+		{
+			UpdateLeafBounds(node);
+			continue;
+		}
+
+		const BvhNode& left = nodes[node.left];
+		const BvhNode& right = nodes[node.left + 1];
+		node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+		node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+	}
+	++nRefits;
+
+	if (Cost() > builtCost * REBUILD_COST_RATIO)
+		Build(x, y, z, r, primitiveIndices.size());
+}
+
+///////////////////////////////////////////////////
+//	Cost()
+//
+//	Surface area heuristic cost of the whole tree, relative
+//	to the area of the root
+///////////////////////////////////////////////////
+float Bvh::Cost() const
+{
+	if (nodes.empty())
+		return 0.0f;
+
+	float rootArea = HalfArea(nodes[0].boundsMin, nodes[0].boundsMax);
+	if (rootArea <= 0.0f)
+		return 0.0f;
+
+	float cost = 0.0f;
+	for (const BvhNode& node : nodes)
+		cost += HalfArea(node.boundsMin, node.boundsMax) * (node.left < 0 ? (float)node.count : 1.0f);
+
+	return cost / rootArea;
+}
+
+///////////////////////////////////////////////////
+//	SplitSubtrees(int, std::vector<int>&)
+//
+//	count: most subtrees wanted
+//	roots: receives the root nodes of the subtrees
+//
+//	Cut the tree into disjoint subtrees that together hold
+//	every primitive, by splitting the largest one into its
+//	children until there are enough or only leaves are left,
+//	so each can be culled on its own thread
+///////////////////////////////////////////////////
+void Bvh::SplitSubtrees(int count, std::vector<int>& roots) const
+{
+	roots.assign(1, 0);
+	if (nodes.empty())
+		return;
+
+	while ((int)roots.size() < count)
+	{
+		int largest = -1;
+		for (std::size_t i = 0; i < roots.size(); ++i)
+		{
+			const BvhNode& node = nodes[roots[i]];
+			if (node.left >= 0 && (largest < 0 || node.count > nodes[roots[largest]].count))
+				largest = (int)i;
+		}
+
+		if (largest < 0)
+			break;
+
+		int left = nodes[roots[largest]].left;
+		roots[largest] = left;
+		roots.push_back(left + 1);
+	}
+}
+
+///////////////////////////////////////////////////
+//	CullFrustum(const Frustum&, GLuint*, int)
+//
+//	frustum: planes to test against
+//	visibleIndices: receives the visible primitives, in tree order
+//	root: node whose subtree is culled, the whole tree by default
+//
+//	Return the number of visible primitives. Subtrees outside a
+//	plane are skipped, subtrees inside every plane are accepted
+//	without further tests, and the spheres of the remaining
+//	leaves are tested with CullSpheres()
+///////////////////////////////////////////////////
+std::size_t Bvh::CullFrustum(const Frustum& frustum, GLuint* visibleIndices, int root) const
+{
+	std::size_t nVisible = 0;
+	if (nodes.empty())
+		return 0;
+
+	std::vector<int> stack;
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const BvhNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		bool outside = false;
+		bool inside = true;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			// corners of the box farthest along and against the plane normal
+			glm::vec3 positive(plane.x >= 0.0f ? node.boundsMax.x : node.boundsMin.x,
+				plane.y >= 0.0f ? node.boundsMax.y : node.boundsMin.y,
+				plane.z >= 0.0f ? node.boundsMax.z : node.boundsMin.z);
+			glm::vec3 negative(plane.x >= 0.0f ? node.boundsMin.x : node.boundsMax.x,
+				plane.y >= 0.0f ? node.boundsMin.y : node.boundsMax.y,
+				plane.z >= 0.0f ? node.boundsMin.z : node.boundsMax.z);
+
+			if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+			{
+				outside = true;
+				break;
+			}
+			if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f)
+				inside = false;
+		}
+
+		if (outside)
+			continue;
+
+		if (inside)
+		{
+			std::copy(primitiveIndices.begin() + node.first, primitiveIndices.begin() + node.first + node.count, visibleIndices + nVisible);
+			nVisible += node.count;
+		}
+		else if (node.left < 0)
+		{
+			std::size_t nLeafVisible = CullSpheres(frustum, &centerX[node.first], &centerY[node.first], &centerZ[node.first],
+				&radius[node.first], node.count, visibleIndices + nVisible);
+
+			// CullSpheres() returns positions inside the leaf
+			for (std::size_t i = 0; i < nLeafVisible; ++i)
+				visibleIndices[nVisible + i] = primitiveIndices[node.first + visibleIndices[nVisible + i]];
+			nVisible += nLeafVisible;
+		}
+		else
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.left + 1);
+		}
+	}
+
+	return nVisible;
+}
+
+///////////////////////////////////////////////////
+//	Raycast(const glm::vec3&, const glm::vec3&, const std::function<float(GLuint)>&, float&)
+//
+//	origin, direction: the ray
+//	intersect: exact test of a primitive, returning the hit distance
+//	           along the ray or a negative value when it is missed
+//	distance: receives the distance of the closest hit
+//
+//	Return the closest primitive hit by the ray, or -1. Children
+//	are visited near to far and boxes farther than the closest
+//	hit so far are skipped
+///////////////////////////////////////////////////
+int Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction,
+	const std::function<float(GLuint)>& intersect, float& distance) const
+{
+	int closest = -1;
+	distance = INFINITE_DISTANCE;
+	if (nodes.empty())
+		return -1;
+
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	std::vector<std::pair<int, float>> stack;
+	float rootEntry = IntersectBox(origin, inverseDirection, nodes[0]);
+	if (rootEntry != INFINITE_DISTANCE)
+		stack.push_back(std::make_pair(0, rootEntry));
+
+	while (!stack.empty())
+	{
+		std::pair<int, float> entry = stack.back();
+		stack.pop_back();
+		if (entry.second >= distance)
+			continue;
+
+		const BvhNode& node = nodes[entry.first];
+		if (node.left < 0)
+		{
+			for (int i = node.first; i < node.first + node.count; ++i)
+			{
+				float hit = intersect(primitiveIndices[i]);
+				if (hit >= 0.0f && hit < distance)
+				{
+					distance = hit;
+					closest = (int)primitiveIndices[i];
+				}
+			}
+			continue;
+		}
+
+		float leftEntry = IntersectBox(origin, inverseDirection, nodes[node.left]);
+		float rightEntry = IntersectBox(origin, inverseDirection, nodes[node.left + 1]);
+
+		// push the farther child first so the nearer one is visited next
+		if (leftEntry <= rightEntry)
+		{
+			if (rightEntry < distance)
+				stack.push_back(std::make_pair(node.left + 1, rightEntry));
+			if (leftEntry < distance)
+				stack.push_back(std::make_pair(node.left, leftEntry));
+		}
+		else
+		{
+			if (leftEntry < distance)
+				stack.push_back(std::make_pair(node.left, leftEntry));
+			if (rightEntry < distance)
+				stack.push_back(std::make_pair(node.left + 1, rightEntry));
+		}
+	}
+
+	return closest;
+}
+
+///////////////////////////////////////////////////
+//	GatherSpheres(const float*, const float*, const float*, const float*)
+//
+//	Copy the spheres into primitiveIndices order
+///////////////////////////////////////////////////
+void Bvh::GatherSpheres(const float* x, const float* y, const float* z, const float* r)
+{
+	std::size_t count = primitiveIndices.size();
+	centerX.resize(count);
+	centerY.resize(count);
+	centerZ.resize(count);
+	radius.resize(count);
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		GLuint primitive = primitiveIndices[i];
+		centerX[i] = x[primitive];
+		centerY[i] = y[primitive];
+		centerZ[i] = z[primitive];
+		radius[i] = r[primitive];
+	}
+}
+
+///////////////////////////////////////////////////
+//	UpdateLeafBounds(BvhNode&)
+//
+//	Fit the node's box around the spheres in its range
+///////////////////////////////////////////////////
+void Bvh::UpdateLeafBounds(BvhNode& node) const
+{
+	node.boundsMin = glm::vec3(INFINITE_DISTANCE);
+	node.boundsMax = glm::vec3(-INFINITE_DISTANCE);
+
+	for (int i = node.first; i < node.first + node.count; ++i)
+	{
+		glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+		node.boundsMin = glm::min(node.boundsMin, center - glm::vec3(radius[i]));
+		node.boundsMax = glm::max(node.boundsMax, center + glm::vec3(radius[i]));
+	}
+}
+
+///////////////////////////////////////////////////
+//	Subdivide(int)
+//
+//	Split nodes top-down along the cheapest binned SAH plane
+//	until splitting no longer lowers the cost
+///////////////////////////////////////////////////
+void Bvh::Subdivide(int nodeIndex)
+{
+	std::vector<int> pending;
+	pending.push_back(nodeIndex);
+
+	while (!pending.empty())
+	{
+		int current = pending.back();
+		pending.pop_back();
+
+		BvhNode node = nodes[current];
+		if (node.count <= 1)
+			continue;
+
+		// bin on the centers, which are what the partition below compares
+		glm::vec3 centroidMin(INFINITE_DISTANCE);
+		glm::vec3 centroidMax(-INFINITE_DISTANCE);
+		for (int i = node.first; i < node.first + node.count; ++i)
+		{
+			glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+			centroidMin = glm::min(centroidMin, center);
+			centroidMax = glm::max(centroidMax, center);
+		}
+
+		float bestCost = INFINITE_DISTANCE;
+		int bestAxis = -1;
+		int bestSplit = 0;
+		const float* centers[3] = { centerX.data(), centerY.data(), centerZ.data() };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f)
+				continue;
+
+			glm::vec3 binMin[SAH_BINS], binMax[SAH_BINS];
+			int binCount[SAH_BINS] = {};
+			for (int b = 0; b < SAH_BINS; ++b)
+			{
+				binMin[b] = glm::vec3(INFINITE_DISTANCE);
+				binMax[b] = glm::vec3(-INFINITE_DISTANCE);
+			}
+
+			float scale = SAH_BINS / extent;
+			for (int i = node.first; i < node.first + node.count; ++i)
+			{
+				int b = std::min(SAH_BINS - 1, (int)((centers[axis][i] - centroidMin[axis]) * scale));
+				glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+				binMin[b] = glm::min(binMin[b], center - glm::vec3(radius[i]));
+				binMax[b] = glm::max(binMax[b], center + glm::vec3(radius[i]));
+				++binCount[b];
+			}
+
+			// sweep from both sides to get the cost of every split between two bins
+			float leftArea[SAH_BINS - 1], rightArea[SAH_BINS - 1];
+			int leftCount[SAH_BINS - 1], rightCount[SAH_BINS - 1];
+			glm::vec3 leftMin(INFINITE_DISTANCE), leftMax(-INFINITE_DISTANCE);
+			glm::vec3 rightMin(INFINITE_DISTANCE), rightMax(-INFINITE_DISTANCE);
+			int leftSum = 0, rightSum = 0;
+			for (int b = 0; b < SAH_BINS - 1; ++b)
+			{
+				leftSum += binCount[b];
+				if (binCount[b] > 0)
+				{
+					leftMin = glm::min(leftMin, binMin[b]);
+					leftMax = glm::max(leftMax, binMax[b]);
+				}
+				leftCount[b] = leftSum;
+				leftArea[b] = leftSum > 0 ? HalfArea(leftMin, leftMax) : 0.0f;
+
+				int rb = SAH_BINS - 1 - b;
+				rightSum += binCount[rb];
+				if (binCount[rb] > 0)
+				{
+					rightMin = glm::min(rightMin, binMin[rb]);
+					rightMax = glm::max(rightMax, binMax[rb]);
+				}
+				rightCount[rb - 1] = rightSum;
+				rightArea[rb - 1] = rightSum > 0 ? HalfArea(rightMin, rightMax) : 0.0f;
+			}
+
+			for (int split = 0; split < SAH_BINS - 1; ++split)
+			{
+				if (leftCount[split] == 0 || rightCount[split] == 0)
+					continue;
+
+				float cost = leftCount[split] * leftArea[split] + rightCount[split] * rightArea[split];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		float leafCost = node.count * HalfArea(node.boundsMin, node.boundsMax);
+		if (bestAxis < 0 || (bestCost >= leafCost && node.count <= MAX_LEAF_SIZE))
+			continue;
+
+		// partition the range in place so the left child's primitives come first
+		float extent = centroidMax[bestAxis] - centroidMin[bestAxis];
+		float scale = SAH_BINS / extent;
+		int i = node.first;
+		int j = node.first + node.count - 1;
+		while (i <= j)
+		{
+			int b = std::min(SAH_BINS - 1, (int)((centers[bestAxis][i] - centroidMin[bestAxis]) * scale));
+			if (b <= bestSplit)
+			{
+				++i;
+				continue;
+			}
+
+			std::swap(primitiveIndices[i], primitiveIndices[j]);
+			std::swap(centerX[i], centerX[j]);
+			std::swap(centerY[i], centerY[j]);
+			std::swap(centerZ[i], centerZ[j]);
+			std::swap(radius[i], radius[j]);
+			--j;
+		}
+
+		int nLeft = i - node.first;
+		if (nLeft == 0 || nLeft == node.count)
+			continue;
+
+		BvhNode left;
+		left.left = -1;
+		left.first = node.first;
+		left.count = nLeft;
+		UpdateLeafBounds(left);
+
+		BvhNode right;
+		right.left = -1;
+		right.first = i;
+		right.count = node.count - nLeft;
+		UpdateLeafBounds(right);
+
+		int leftIndex = (int)nodes.size();
+		nodes[current].left = leftIndex;
+		nodes.push_back(left);
+		nodes.push_back(right);
+
+		pending.push_back(leftIndex);
+		pending.push_back(leftIndex + 1);
+	}
+}
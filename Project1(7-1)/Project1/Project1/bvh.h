@@ -0,0 +1,69 @@
+///////////////////////////////////////////////////////////////////////////////
+// bvh.h
+// ========
+// bounding volume hierarchy over bounding spheres, for culling and ray queries
+//
+// Nodes are built top-down with the binned surface area heuristic. When the
+// primitives move the tree is refitted in place, and rebuilt only once the
+// refitted tree has become much more expensive to traverse than a fresh one.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "frustum.h"
+
+// Node of the hierarchy; every node covers a contiguous range of
+// Bvh::primitiveIndices, so a whole subtree can be emitted at once
+struct BvhNode
+{
+	glm::vec3 boundsMin;
+	int left;               // index of the left child, the right one follows it; -1 for leaves
+	glm::vec3 boundsMax;
+	int first;              // first primitive of the node in primitiveIndices
+	int count;              // number of primitives below the node
+};
+
+// Slab test of a ray against a box, inverseDirection being 1 / direction; return the entry distance,
+// 0 from inside the box, or -1 when the ray misses. Slabs the ray runs parallel to, where 1 / direction
+// is infinite, only check that the origin lies between them
+float IntersectRayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+class Bvh
+{
+public:
+	std::vector<BvhNode> nodes;             // nodes[0] is the root, children come after their parent
+	std::vector<GLuint> primitiveIndices;   // primitive of each slot, grouped by leaf
+
+	// Spheres of the primitives in primitiveIndices order, as separate arrays for SIMD tests in the leaves
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+
+	float builtCost = 0.0f;                 // SAH cost right after the last full build
+	int nBuilds = 0;
+	int nRefits = 0;
+
+public:
+	void Build(const float* x, const float* y, const float* z, const float* r, std::size_t count);
+	void Refit(const float* x, const float* y, const float* z, const float* r);
+	float Cost() const;
+
+	void SplitSubtrees(int count, std::vector<int>& roots) const;
+	std::size_t CullFrustum(const Frustum& frustum, GLuint* visibleIndices, int root = 0) const;
+	int Raycast(const glm::vec3& origin, const glm::vec3& direction,
+		const std::function<float(GLuint)>& intersect, float& distance) const;
+
+private:
+	void GatherSpheres(const float* x, const float* y, const float* z, const float* r);
+	void UpdateLeafBounds(BvhNode& node) const;
+	void Subdivide(int nodeIndex);
+};
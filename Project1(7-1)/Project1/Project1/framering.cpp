@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////////
+// framering.cpp
+// ========
+// persistently mapped ring buffer for the data written every frame
+///////////////////////////////////////////////////////////////////////////////
+
+#include "framering.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+///////////////////////////////////////////////////
+//	Reserve(GLsizeiptr, int)
+//
+//	size: bytes of one range
+//	count: ranges of that size written per frame
+//
+//	Account for data written every frame; call it for
+//	everything the frame writes before Create(), which
+//	sizes the regions from the sum
+///////////////////////////////////////////////////
+void FrameRing::Reserve(GLsizeiptr size, int count)
+{
+	reserved += std::max<GLsizeiptr>(size, 1) * count;
+	nReserved += count;
+}
+
+///////////////////////////////////////////////////
+//	Create()
+//
+//	Allocate the immutable buffer with room for every
+//	reserved range in each region, and map it for the
+//	lifetime of the buffer
+///////////////////////////////////////////////////
+bool FrameRing::Create()
+{
+	GLint uniformAlignment = 0;
+	GLint storageAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+	alignment = std::max<GLsizeiptr>(std::max(uniformAlignment, storageAlignment), 16);
+
+	// every range may start up to one alignment after the end of the previous one
+	regionSize = (reserved + nReserved * alignment + alignment - 1) / alignment * alignment;
+
+	// coherent, so writes reach the GPU without flushing; the fences keep them off ranges still read
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferStorage(GL_COPY_WRITE_BUFFER, regionSize * FRAME_COUNT, nullptr, flags);
+	mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionSize * FRAME_COUNT, flags);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (!mapped)
+	{
+		std::cout << "ERROR::FRAME_RING::MAP_FAILED" << std::endl;
+		return false;
+	}
+
+	region = 0;
+	used = 0;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	BeginFrame()
+//
+//	Wait until the GPU finished the frame that last wrote
+//	the next region, timing the wait when there is one,
+//	and start handing out that region
+///////////////////////////////////////////////////
+void FrameRing::BeginFrame()
+{
+	lastStallMilliseconds = 0.0;
+
+	GLsync& fence = fences[region];
+	if (fence)
+	{
+		// polling first tells a free region from a stall without starting the clock
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			// the flush makes sure the fence gets submitted, or the wait could never end
+			const GLuint64 ONE_MILLISECOND = 1000000;
+			do
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, ONE_MILLISECOND);
+			while (status == GL_TIMEOUT_EXPIRED);
+
+			std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - start;
+			lastStallMilliseconds = waited.count();
+			stallMilliseconds += lastStallMilliseconds;
+			++nStalls;
+		}
+
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	used = 0;
+}
+
+///////////////////////////////////////////////////
+//	Allocate(GLsizeiptr)
+//
+//	size: bytes to write
+//
+//	Hand out an aligned range of the current region, valid
+//	until EndFrame(); when the region is full, data is
+//	nullptr and the caller keeps last frame's binding.
+//	Safe to call from worker threads between BeginFrame()
+//	and EndFrame()
+///////////////////////////////////////////////////
+FrameRingRange FrameRing::Allocate(GLsizeiptr size)
+{
+	// ranges are bound, and an empty binding is an error
+	size = std::max<GLsizeiptr>(size, 1);
+
+	std::lock_guard<std::mutex> lock(allocationMutex);
+
+	GLsizeiptr start = (used + alignment - 1) / alignment * alignment;
+	if (start + size > regionSize)
+	{
+		if (nOverflows++ == 0)
+			std::cout << "ERROR::FRAME_RING::REGION_FULL " << size << " bytes past " << used << " of " << regionSize << std::endl;
+		return { nullptr, 0, 0 };
+	}
+
+	used = start + size;
+	peakUsed = std::max(peakUsed, used);
+
+	GLintptr offset = region * regionSize + start;
+	return { mapped + offset, offset, size };
+}
+
+///////////////////////////////////////////////////
+//	Write(const void*, GLsizeiptr)
+//
+//	Allocate a range and copy the data into it
+///////////////////////////////////////////////////
+FrameRingRange FrameRing::Write(const void* data, GLsizeiptr size)
+{
+	FrameRingRange range = Allocate(size);
+	if (range.data && data)
+		std::memcpy(range.data, data, size);
+	return range;
+}
+
+///////////////////////////////////////////////////
+//	BindRange(GLenum, GLuint, const FrameRingRange&)
+//
+//	target: GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+//	binding: binding point the shaders read
+//
+//	Bind an allocated range; a refused one is not bound
+///////////////////////////////////////////////////
+void FrameRing::BindRange(GLenum target, GLuint binding, const FrameRingRange& range) const
+{
+	if (range.data)
+		glBindBufferRange(target, binding, buffer, range.offset, range.size);
+}
+
+///////////////////////////////////////////////////
+//	DropView()
+//
+//	Count a view left without draws because a range it
+//	needed was refused; safe to call from worker threads
+///////////////////////////////////////////////////
+void FrameRing::DropView()
+{
+	std::lock_guard<std::mutex> lock(allocationMutex);
+	++nDroppedViews;
+}
+
+///////////////////////////////////////////////////
+//	EndFrame()
+//
+//	Fence the commands that read the current region and
+//	move on to the next one
+///////////////////////////////////////////////////
+void FrameRing::EndFrame()
+{
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % FRAME_COUNT;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Release the fences and unmap and delete the buffer
+///////////////////////////////////////////////////
+void FrameRing::Destroy()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = 0;
+	}
+
+	if (mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &buffer);
+	buffer = 0;
+	mapped = nullptr;
+}
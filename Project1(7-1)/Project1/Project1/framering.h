@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// framering.h
+// ========
+// persistently mapped ring buffer for the data written every frame
+//
+// One buffer is mapped once for the whole run and split into FRAME_COUNT
+// regions. Each frame the CPU writes its constants, culling results and
+// indirect commands into the next region and binds ranges of it; a fence
+// placed at the end of the frame tells when the GPU is done reading, so a
+// region is only reused once the fence FRAME_COUNT frames back signaled.
+// Waiting on that fence is the only time the CPU stalls on the GPU, and it
+// is counted. Ranges may be allocated from several threads at once.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <mutex>
+
+// Part of the current frame's region handed out by Allocate()
+struct FrameRingRange
+{
+	void* data;             // where the CPU writes, nullptr when the region is full
+	GLintptr offset;        // from the start of the buffer, for binding
+	GLsizeiptr size;
+};
+
+class FrameRing
+{
+public:
+	static const int FRAME_COUNT = 3;   // frames the CPU may be ahead of the GPU
+
+	GLuint buffer = 0;
+	unsigned char* mapped = nullptr;
+	GLsizeiptr regionSize = 0;
+	GLsizeiptr alignment = 0;           // of every range, satisfies uniform and storage bindings
+
+	// Frames that waited for the GPU and the time they waited, since startup
+	int nStalls = 0;
+	double stallMilliseconds = 0.0;
+	double lastStallMilliseconds = 0.0; // wait of the last frame, 0 when it did not stall
+
+	GLsizeiptr peakUsed = 0;            // most bytes a frame used
+	int nOverflows = 0;                 // allocations refused because the region was full
+	int nDroppedViews = 0;              // views recorded without draws because one of their ranges was refused
+
+public:
+	void Reserve(GLsizeiptr size, int count = 1);
+	bool Create();
+	void BeginFrame();
+	FrameRingRange Allocate(GLsizeiptr size);
+	FrameRingRange Write(const void* data, GLsizeiptr size);
+	void BindRange(GLenum target, GLuint binding, const FrameRingRange& range) const;
+	void DropView();
+	void EndFrame();
+	void Destroy();
+
+private:
+	GLsizeiptr reserved = 0;            // bytes and ranges one frame needs, summed by Reserve()
+	int nReserved = 0;
+
+	GLsync fences[FRAME_COUNT] = {};
+	int region = 0;                     // region written this frame
+	GLsizeiptr used = 0;                // bytes of it handed out
+	std::mutex allocationMutex;         // guards used, peakUsed, nOverflows and nDroppedViews
+};
@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustum.cpp
+// ========
+// view frustum planes and SIMD culling of bounding spheres
+///////////////////////////////////////////////////////////////////////////////
+
+#include "frustum.h"
+
+// AVX when the compiler targets it (/arch:AVX or /arch:AVX2), SSE2 otherwise
+#if defined(__AVX__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////
+//	ExtractFrustum(const glm::mat4&)
+//
+//	viewProjection: projection * view matrix of the camera
+//
+//	Extract the frustum planes from the rows of the clip matrix
+//	and normalize them so plane distances are in world units
+///////////////////////////////////////////////////
+Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+	// glm matrices are column-major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; ++i)
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];     // left
+	frustum.planes[1] = rows[3] - rows[0];     // right
+	frustum.planes[2] = rows[3] + rows[1];     // bottom
+	frustum.planes[3] = rows[3] - rows[1];     // top
+	frustum.planes[4] = rows[3] + rows[2];     // near
+	frustum.planes[5] = rows[3] - rows[2];     // far
+
+	for (glm::vec4& plane : frustum.planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	return frustum;
+}
+
+///////////////////////////////////////////////////
+//	CullSpheres(const Frustum&, const float*, const float*, const float*, const float*, std::size_t, GLuint*)
+//
+//	frustum: planes to test against
+//	centerX, centerY, centerZ, radius: world space spheres, one entry per instance
+//	count: number of spheres
+//	visibleIndices: receives the indices of the visible spheres, in increasing order
+//
+//	Return the number of visible spheres; a sphere is culled when
+//	it lies entirely behind any of the planes
+///////////////////////////////////////////////////
+std::size_t CullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+	const float* radius, std::size_t count, GLuint* visibleIndices)
+{
+	std::size_t nVisible = 0;
+	std::size_t i = 0;
+
+#if defined(__AVX__)
+	const int LANES = 8;
+
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+
+	for (; i + LANES <= count; i += LANES)
+	{
+		__m256 x = _mm256_loadu_ps(centerX + i);
+		__m256 y = _mm256_loadu_ps(centerY + i);
+		__m256 z = _mm256_loadu_ps(centerZ + i);
+		__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planeX[p], x), _mm256_mul_ps(planeY[p], y)),
+				_mm256_add_ps(_mm256_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < LANES; ++lane)
+		{
+			if (mask & (1 << lane))
+				visibleIndices[nVisible++] = (GLuint)(i + lane);
+		}
+	}
+#else
+	const int LANES = 4;
+
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+		planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+		planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+		planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+
+	for (; i + LANES <= count; i += LANES)
+	{
+		__m128 x = _mm_loadu_ps(centerX + i);
+		__m128 y = _mm_loadu_ps(centerY + i);
+		__m128 z = _mm_loadu_ps(centerZ + i);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < LANES; ++lane)
+		{
+			if (mask & (1 << lane))
+				visibleIndices[nVisible++] = (GLuint)(i + lane);
+		}
+	}
+#endif
+
+	// remaining spheres that do not fill a whole SIMD register
+	for (; i < count; ++i)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; ++p)
+		{
+			const glm::vec4& plane = frustum.planes[p];
+			inside = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w >= -radius[i];
+		}
+
+		if (inside)
+			visibleIndices[nVisible++] = (GLuint)i;
+	}
+
+	return nVisible;
+}
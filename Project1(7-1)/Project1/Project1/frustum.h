@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// frustum.h
+// ========
+// view frustum planes and SIMD culling of bounding spheres
+//
+// Spheres are passed as separate x, y, z and radius arrays (structure of
+// arrays) so four (SSE) or eight (AVX) of them are tested per instruction.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Six planes (left, right, bottom, top, near, far) with normals pointing
+// inside; a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+std::size_t CullSpheres(const Frustum& frustum, const float* centerX, const float* centerY, const float* centerZ,
+	const float* radius, std::size_t count, GLuint* visibleIndices);
@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// gbuffer.cpp
+// ========
+// render targets of the deferred shading path
+///////////////////////////////////////////////////////////////////////////////
+
+#include "gbuffer.h"
+
+#include <iostream>
+
+namespace
+{
+	///////////////////////////////////////////////////
+	//	CreateTarget(GLenum, int, int)
+	//
+	//	Allocate a single level texture read with texelFetch
+	///////////////////////////////////////////////////
+	GLuint CreateTarget(GLenum internalFormat, int width, int height)
+	{
+		GLuint textureId;
+		glGenTextures(1, &textureId);
+		glBindTexture(GL_TEXTURE_2D, textureId);
+		glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return textureId;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Create(int, int)
+//
+//	width, height: size of the framebuffer the G-buffer is drawn for
+//
+//	Create the render targets and attach them to a framebuffer
+//	object; return false when the framebuffer is not complete
+///////////////////////////////////////////////////
+bool GBuffer::Create(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+
+	albedoTexture = CreateTarget(GL_RGBA8, width, height);
+	normalTexture = CreateTarget(GL_RG16F, width, height);
+	depthTexture = CreateTarget(GL_DEPTH_COMPONENT32F, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+
+	const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::GBUFFER::INCOMPLETE_FRAMEBUFFER 0x" << std::hex << status << std::dec << std::endl;
+		Destroy();
+		return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	BindTextures(RenderStateCache&)
+//
+//	Bind the render targets on the texture units the
+//	lighting passes sample them from
+///////////////////////////////////////////////////
+void GBuffer::BindTextures(RenderStateCache& state) const
+{
+	state.BindTexture(GBUFFER_ALBEDO_UNIT, GL_TEXTURE_2D, albedoTexture);
+	state.BindTexture(GBUFFER_NORMAL_UNIT, GL_TEXTURE_2D, normalTexture);
+	state.BindTexture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D, depthTexture);
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Release the framebuffer and its render targets
+///////////////////////////////////////////////////
+void GBuffer::Destroy()
+{
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &albedoTexture);
+	glDeleteTextures(1, &normalTexture);
+	glDeleteTextures(1, &depthTexture);
+	fbo = 0;
+	albedoTexture = 0;
+	normalTexture = 0;
+	depthTexture = 0;
+	width = 0;
+	height = 0;
+}
@@ -0,0 +1,37 @@
+///////////////////////////////////////////////////////////////////////////////
+// gbuffer.h
+// ========
+// render targets of the deferred shading path
+//
+// The geometry pass writes the surface of every pixel once; the lighting
+// passes then read it back instead of shading each object per light.
+// Per pixel: albedo RGBA8 (alpha 0 marks unlit surfaces such as the lamp
+// markers), octahedral normal RG16F and a 32-bit float depth.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include "renderstate.h"
+
+// Texture units the lighting passes read the G-buffer from
+const GLint GBUFFER_ALBEDO_UNIT = 0;
+const GLint GBUFFER_NORMAL_UNIT = 1;
+const GLint GBUFFER_DEPTH_UNIT = 2;
+
+class GBuffer
+{
+public:
+	GLuint fbo = 0;
+	GLuint albedoTexture = 0;
+	GLuint normalTexture = 0;
+	GLuint depthTexture = 0;
+	int width = 0;
+	int height = 0;
+
+public:
+	bool Create(int width, int height);
+	void BindTextures(RenderStateCache& state) const;
+	void Destroy();
+};
@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.cpp
+// ========
+// point lights assigned to the clusters (froxels) of the view frustum
+///////////////////////////////////////////////////////////////////////////////
+
+#include "lightclusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+///////////////////////////////////////////////////
+//	ReserveRanges(FrameRing&, std::size_t)
+//
+//	ring: frame ring not created yet
+//	maxLights: most lights a frame assigns
+//
+//	Allocate the clusters and account for the light, cluster,
+//	light index and light rectangle lists, which change
+//	every frame; the index list is reserved for every
+//	cluster filled up to MAX_CLUSTER_LIGHTS
+///////////////////////////////////////////////////
+void LightClusters::ReserveRanges(FrameRing& ring, std::size_t maxLights)
+{
+	clusters.resize(CLUSTER_COUNT);
+
+	ring.Reserve(sizeof(PointLight) * maxLights);
+	ring.Reserve(sizeof(LightCluster) * CLUSTER_COUNT);
+	ring.Reserve(sizeof(GLuint) * std::min<std::size_t>(maxLights, MAX_CLUSTER_LIGHTS) * CLUSTER_COUNT);
+	ring.Reserve(sizeof(glm::vec4) * maxLights);
+}
+
+///////////////////////////////////////////////////
+//	AssignLights(FrameRing&, const std::vector<PointLight>&, const glm::mat4&, const glm::mat4&, float, float)
+//
+//	ring: receives the lists
+//	lights: world space point lights of the frame
+//	view, projection: camera matrices the frame is drawn with
+//	nearPlane, farPlane: depth range of the projection
+//
+//	Add every light to the clusters its sphere overlaps and
+//	write the lights, the cluster ranges, the index list
+//	and the screen rectangles of the lights to the ring. A
+//	cluster keeps its first MAX_CLUSTER_LIGHTS lights, the
+//	rest are counted in nDroppedLightIndices
+///////////////////////////////////////////////////
+void LightClusters::AssignLights(FrameRing& ring, const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+	float nearPlane, float farPlane)
+{
+	depthScale = GRID_Z / std::log(farPlane / nearPlane);
+	depthBias = -GRID_Z * std::log(nearPlane) / std::log(farPlane / nearPlane);
+
+	for (LightCluster& cluster : clusters)
+		cluster.count = 0;
+
+	// first pass: count the lights of every cluster
+	nDroppedLightIndices = 0;
+	std::vector<ClusterRange> ranges(lights.size());
+	std::vector<bool> visible(lights.size());
+	lightRects.resize(lights.size());
+	for (std::size_t i = 0; i < lights.size(); ++i)
+	{
+		visible[i] = FindClusterRange(lights[i], view, projection, nearPlane, farPlane, ranges[i], lightRects[i]);
+		if (!visible[i])
+			continue;
+
+		const ClusterRange& range = ranges[i];
+		for (int z = range.minZ; z <= range.maxZ; ++z)
+			for (int y = range.minY; y <= range.maxY; ++y)
+				for (int x = range.minX; x <= range.maxX; ++x)
+				{
+					LightCluster& cluster = clusters[x + GRID_X * (y + GRID_Y * z)];
+					if (cluster.count < MAX_CLUSTER_LIGHTS)
+						++cluster.count;
+					else
+						++nDroppedLightIndices;
+				}
+	}
+
+	// prefix sum of the counts gives where each cluster starts in the index list
+	GLuint offset = 0;
+	maxClusterLights = 0;
+	for (LightCluster& cluster : clusters)
+	{
+		cluster.offset = offset;
+		offset += cluster.count;
+		maxClusterLights = std::max(maxClusterLights, cluster.count);
+		cluster.count = 0;
+	}
+
+	// second pass: write the light indices, counts are rebuilt as the cursor of each cluster;
+	// lights come in the same order, so the same ones are left out
+	lightIndices.resize(offset);
+	for (std::size_t i = 0; i < lights.size(); ++i)
+	{
+		if (!visible[i])
+			continue;
+
+		const ClusterRange& range = ranges[i];
+		for (int z = range.minZ; z <= range.maxZ; ++z)
+			for (int y = range.minY; y <= range.maxY; ++y)
+				for (int x = range.minX; x <= range.maxX; ++x)
+				{
+					LightCluster& cluster = clusters[x + GRID_X * (y + GRID_Y * z)];
+					if (cluster.count < MAX_CLUSTER_LIGHTS)
+						lightIndices[cluster.offset + cluster.count++] = (GLuint)i;
+				}
+	}
+
+	nLights = lights.size();
+
+	// the light and index lists change size from frame to frame, which ring ranges do not mind
+	lightRange = ring.Write(lights.data(), sizeof(PointLight) * lights.size());
+	lightRectRange = ring.Write(lightRects.data(), sizeof(glm::vec4) * lightRects.size());
+	lightIndexRange = ring.Write(lightIndices.data(), sizeof(GLuint) * lightIndices.size());
+	clusterRange = ring.Write(clusters.data(), sizeof(LightCluster) * CLUSTER_COUNT);
+}
+
+///////////////////////////////////////////////////
+//	BindBuffers(const FrameRing&)
+//
+//	Bind the ranges of the last assignment to their shader
+//	binding points
+///////////////////////////////////////////////////
+void LightClusters::BindBuffers(const FrameRing& ring) const
+{
+	ring.BindRange(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, lightRange);
+	ring.BindRange(GL_SHADER_STORAGE_BUFFER, CLUSTER_BUFFER_BINDING, clusterRange);
+	ring.BindRange(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BUFFER_BINDING, lightIndexRange);
+	ring.BindRange(GL_SHADER_STORAGE_BUFFER, LIGHT_RECT_BUFFER_BINDING, lightRectRange);
+}
+
+///////////////////////////////////////////////////
+//	FindClusterRange(const PointLight&, const glm::mat4&, const glm::mat4&, float, float, ClusterRange&, glm::vec4&)
+//
+//	Compute the screen rectangle and the block of clusters
+//	covered by the view space box around the light's sphere;
+//	return false when the light cannot reach anything inside
+//	the frustum, the rectangle is then empty
+///////////////////////////////////////////////////
+bool LightClusters::FindClusterRange(const PointLight& light, const glm::mat4& view, const glm::mat4& projection,
+	float nearPlane, float farPlane, ClusterRange& range, glm::vec4& rect) const
+{
+	rect = glm::vec4(0.0f);
+
+	glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+
+	// the camera looks down -z, depths are positive in front of it
+	float minDepth = -center.z - light.radius;
+	float maxDepth = -center.z + light.radius;
+	if (maxDepth < nearPlane || minDepth > farPlane)
+		return false;
+	minDepth = std::max(minDepth, nearPlane);
+	maxDepth = std::min(maxDepth, farPlane);
+
+	range.minZ = DepthSlice(minDepth);
+	range.maxZ = DepthSlice(maxDepth);
+
+	// the box corners are all in front of the camera, so their projections bound the box on screen
+	glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec4 point(center.x + ((corner & 1) ? light.radius : -light.radius),
+			center.y + ((corner & 2) ? light.radius : -light.radius),
+			(corner & 4) ? -maxDepth : -minDepth,
+			1.0f);
+		glm::vec4 clip = projection * point;
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+
+	if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+		return false;
+
+	ndcMin = glm::max(ndcMin, glm::vec2(-1.0f));
+	ndcMax = glm::min(ndcMax, glm::vec2(1.0f));
+	rect = glm::vec4(ndcMin.x, ndcMin.y, ndcMax.x, ndcMax.y);
+
+	range.minX = std::max(0, (int)std::floor((ndcMin.x * 0.5f + 0.5f) * GRID_X));
+	range.maxX = std::min(GRID_X - 1, (int)std::floor((ndcMax.x * 0.5f + 0.5f) * GRID_X));
+	range.minY = std::max(0, (int)std::floor((ndcMin.y * 0.5f + 0.5f) * GRID_Y));
+	range.maxY = std::min(GRID_Y - 1, (int)std::floor((ndcMax.y * 0.5f + 0.5f) * GRID_Y));
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	DepthSlice(float)
+//
+//	Return the depth slice of a positive view depth, with
+//	the same formula as the fragment shader
+///////////////////////////////////////////////////
+int LightClusters::DepthSlice(float depth) const
+{
+	int slice = (int)std::floor(std::log(depth) * depthScale + depthBias);
+	return std::min(std::max(slice, 0), GRID_Z - 1);
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// lightclusters.h
+// ========
+// point lights assigned to the clusters (froxels) of the view frustum
+//
+// The frustum is split into a grid of tiles on screen and exponential slices
+// in depth. Every frame each light is added to the clusters its sphere of
+// influence overlaps, so a fragment only loops over the lights of its own
+// cluster instead of every light in the scene. The screen rectangle of each
+// sphere is kept too; the deferred path draws it as the light's volume.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "framering.h"
+
+// Point light read by the fragment shader from an SSBO, std430 layout
+struct PointLight
+{
+	glm::vec3 position;     // world space
+	float radius;           // distance at which the light fades out completely
+	glm::vec3 color;
+	GLint shadowSlot;       // cube of the point shadow maps, -1 when the light casts no shadow
+};
+
+// Lights overlapping one cluster, as a range of the light index list
+struct LightCluster
+{
+	GLuint offset;          // first entry in the light index list
+	GLuint count;
+};
+
+// Shader storage binding points of the light buffers, after the scene buffers
+const GLuint LIGHT_BUFFER_BINDING = 3;
+const GLuint CLUSTER_BUFFER_BINDING = 4;
+const GLuint LIGHT_INDEX_BUFFER_BINDING = 5;
+const GLuint LIGHT_RECT_BUFFER_BINDING = 6;
+
+class LightClusters
+{
+public:
+	// Clusters along x and y on screen and along the view depth
+	static const int GRID_X = 16;
+	static const int GRID_Y = 9;
+	static const int GRID_Z = 24;
+	static const int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+
+	// Lights a cluster keeps; the index list is reserved for this many in every cluster
+	static const GLuint MAX_CLUSTER_LIGHTS = 64;
+
+	std::vector<LightCluster> clusters;
+	std::vector<GLuint> lightIndices;       // lights of every cluster, cluster after cluster
+	std::vector<glm::vec4> lightRects;      // normalized device xy min and max of every light, empty when culled
+
+	// Slice of a view depth d is floor(log(d) * depthScale + depthBias)
+	float depthScale = 0.0f;
+	float depthBias = 0.0f;
+
+	std::size_t nLights = 0;
+	GLuint maxClusterLights = 0;            // most lights any cluster received last frame
+	std::size_t nDroppedLightIndices = 0;   // lights left out of full clusters last frame
+
+	// Lists of the last assignment, written to the frame ring
+	FrameRingRange lightRange = {};
+	FrameRingRange clusterRange = {};
+	FrameRingRange lightIndexRange = {};
+	FrameRingRange lightRectRange = {};
+
+public:
+	void ReserveRanges(FrameRing& ring, std::size_t maxLights);
+	void AssignLights(FrameRing& ring, const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+		float nearPlane, float farPlane);
+	void BindBuffers(const FrameRing& ring) const;
+
+private:
+	struct ClusterRange
+	{
+		int minX, maxX;
+		int minY, maxY;
+		int minZ, maxZ;
+	};
+
+	bool FindClusterRange(const PointLight& light, const glm::mat4& view, const glm::mat4& projection,
+		float nearPlane, float farPlane, ClusterRange& range, glm::vec4& rect) const;
+	int DepthSlice(float depth) const;
+};
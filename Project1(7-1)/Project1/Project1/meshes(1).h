@@ -1,7 +1,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 // meshes.h
 // ========
-// create meshes for various 3D primitives: plane, pyramid, cube, cylinder, torus, sphere
+// create meshes for various 3D primitives: plane, pyramid, cube, cone, cylinder, torus, sphere
 //
 //  AUTHOR: Brian Battersby - SNHU Instructor / Computer Science
 //	Created for CS-330-Computational Graphics and Visualization, Nov. 7th, 2022
@@ -13,18 +13,38 @@
 
 #include <glm/glm.hpp>
 
+#include <vector>
+
+// Layout of the shared vertex buffer
+enum MeshVertexFormat
+{
+	MESH_VERTEX_FORMAT_FLOAT,   // 32 bytes: float position, normal and texture coords
+	MESH_VERTEX_FORMAT_PACKED   // 16 bytes: 16-bit position within the mesh's box, 10:10:10:2 normal, 16-bit texture coords
+};
+
 class Meshes
 {
-	// Stores the GL data relative to a given mesh
+public:
+	// Stores where a given mesh lives inside the shared vertex and index buffers
 	struct GLMesh
 	{
-		GLuint vao;         // Handle for the vertex array object
-		GLuint vbos[2];     // Handles for the vertex buffer objects
+		GLint baseVertex;   // Offset of the mesh's first vertex in the shared vertex buffer
+		GLuint firstIndex;  // Offset of the mesh's first index in the shared index buffer
 		GLuint nVertices;	// Number of vertices for the mesh
 		GLuint nIndices;    // Number of indices for the mesh
+		glm::vec3 boundsCenter; // Center of the mesh's bounding box and sphere in model space
+		glm::vec3 boundsHalfExtent;
+		float boundsRadius;
+		glm::vec3 positionOffset;   // model space position = positionOffset + positionScale * vertex position,
+		glm::vec3 positionScale;    // which undoes the quantization of the packed format
 	};
 
-public:
+	// Every mesh is suballocated from one vertex buffer and one index buffer,
+	// so a single VAO is bound for all of them
+	GLuint vao;         // Handle for the shared vertex array object
+	GLuint vbos[2];     // Handles for the shared vertex and index buffers
+	MeshVertexFormat vertexFormat;
+
 	GLMesh gBoxMesh;
 	GLMesh gConeMesh;
 	GLMesh gCylinderMesh;
@@ -37,14 +57,14 @@ public:
 	GLMesh gTorusMesh;
 
 public:
-	void CreateMeshes();
+	void CreateMeshes(MeshVertexFormat format);
 	void DestroyMeshes();
 
 private:
 	void UCreatePlaneMesh(GLMesh& mesh);
 	//void UCreatePrismMesh(GLMesh& mesh);
 	void UCreateBoxMesh(GLMesh& mesh);
-	//void UCreateConeMesh(GLMesh& mesh);
+	void UCreateConeMesh(GLMesh& mesh);
 	void UCreateCylinderMesh(GLMesh& mesh);
 	void UCreateTaperedCylinderMesh(GLMesh& mesh);
 	void UCreateTorusMesh(GLMesh& mesh);
@@ -52,7 +72,16 @@ private:
 	//void UCreatePyramid4Mesh(GLMesh& mesh);
 	void UCreateSphereMesh(GLMesh& mesh);
 
-	void UDestroyMesh(GLMesh& mesh);
+	void UAddMesh(GLMesh& mesh, const GLfloat* verts, const GLuint* indices);
+	void UStageMesh(GLMesh& mesh, GLfloat*& verts, GLuint*& indices);
+	void UComputeBounds(GLMesh& mesh);
+	void UOptimizeMesh(GLMesh& mesh, const char* name);
+	void UCreateSharedBuffers();
+
+	// Interleaved vertex data and indices of every mesh, kept until uploaded
+	std::vector<GLfloat> stagedVertices;
+	std::vector<GLuint> stagedIndices;
+	std::vector<GLMesh*> stagedMeshes;
 
 	void CalculateTriangleNormal(glm::vec3 px, glm::vec3 py, glm::vec3 pz);
 };
\ No newline at end of file
@@ -0,0 +1,401 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshgenerator.cpp
+// ========
+// parametric primitives: cylinder, cone, sphere, icosphere, torus, box
+///////////////////////////////////////////////////////////////////////////////
+
+#include "meshgenerator.h"
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	const float TWO_PI = glm::radians(360.0f);
+
+	// Twelve corners and twenty faces of the icosahedron, counterclockwise seen from outside
+	const float GOLDEN = 1.6180339887f;
+	const glm::vec3 ICOSAHEDRON_CORNERS[12] = {
+		{ -1.0f, GOLDEN, 0.0f }, { 1.0f, GOLDEN, 0.0f }, { -1.0f, -GOLDEN, 0.0f }, { 1.0f, -GOLDEN, 0.0f },
+		{ 0.0f, -1.0f, GOLDEN }, { 0.0f, 1.0f, GOLDEN }, { 0.0f, -1.0f, -GOLDEN }, { 0.0f, 1.0f, -GOLDEN },
+		{ GOLDEN, 0.0f, -1.0f }, { GOLDEN, 0.0f, 1.0f }, { -GOLDEN, 0.0f, -1.0f }, { -GOLDEN, 0.0f, 1.0f }
+	};
+	const int ICOSAHEDRON_FACES[20][3] = {
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 }
+	};
+
+	// Outward normal, and the two axes the face's texture coordinates run along
+	const glm::vec3 BOX_FACES[6][3] = {
+		{ { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+		{ { 0.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } },
+		{ { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+		{ { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }
+	};
+
+	// Write one interleaved vertex and step past it
+	void WriteVertex(GLfloat*& out, const glm::vec3& position, const glm::vec3& normal, float u, float v)
+	{
+		out[0] = position.x;
+		out[1] = position.y;
+		out[2] = position.z;
+		out[3] = normal.x;
+		out[4] = normal.y;
+		out[5] = normal.z;
+		out[6] = u;
+		out[7] = v;
+		out += GENERATED_FLOATS_PER_VERTEX;
+	}
+
+	void WriteTriangle(GLuint*& out, GLuint a, GLuint b, GLuint c)
+	{
+		out[0] = a;
+		out[1] = b;
+		out[2] = c;
+		out += 3;
+	}
+
+	// Texture coordinates of a point on the unit sphere, wrapped around y
+	void SphereUV(const glm::vec3& normal, float& u, float& v)
+	{
+		u = std::atan2(normal.x, normal.z) / TWO_PI + 0.5f;
+		v = normal.y * 0.5f + 0.5f;
+	}
+
+	// Cap of a cylinder or cone: a center vertex and a ring facing up or down, one triangle per segment
+	void WriteCap(int segments, float radius, float y, bool up, GLuint first, GLfloat*& vertices, GLuint*& indices)
+	{
+		glm::vec3 normal(0.0f, up ? 1.0f : -1.0f, 0.0f);
+		WriteVertex(vertices, glm::vec3(0.0f, y, 0.0f), normal, 0.5f, 0.5f);
+		for (int i = 0; i < segments; ++i)
+		{
+			// the bottom runs the other way, so both caps face outward
+			float angle = TWO_PI * (float)(up ? i : segments - i) / (float)segments;
+			float c = std::cos(angle);
+			float s = std::sin(angle);
+			WriteVertex(vertices, glm::vec3(radius * c, y, -radius * s), normal, 0.5f + 0.5f * c, 0.5f + 0.5f * s);
+			WriteTriangle(indices, first, first + 1 + i, first + 1 + (i + 1) % segments);
+		}
+	}
+
+	// Side of a cylinder or cone: a top and a bottom vertex per column, the seam column repeated
+	void WriteSide(int segments, float bottomRadius, float topRadius, GLuint first, GLfloat*& vertices, GLuint*& indices)
+	{
+		// the normals lean up as much as the side narrows; a cone's tip is split per column
+		for (int i = 0; i <= segments; ++i)
+		{
+			float u = (float)i / (float)segments;
+			float c = std::cos(TWO_PI * u);
+			float s = std::sin(TWO_PI * u);
+			glm::vec3 normal = glm::normalize(glm::vec3(c, bottomRadius - topRadius, -s));
+			WriteVertex(vertices, glm::vec3(topRadius * c, 1.0f, -topRadius * s), normal, u, 1.0f);
+			WriteVertex(vertices, glm::vec3(bottomRadius * c, 0.0f, -bottomRadius * s), normal, u, 0.0f);
+		}
+
+		// a quad per column, or a single triangle up to a cone's tip
+		for (int i = 0; i < segments; ++i)
+		{
+			GLuint top = first + 2 * i;
+			if (topRadius > 0.0f)
+			{
+				WriteTriangle(indices, top, top + 1, top + 2);
+				WriteTriangle(indices, top + 2, top + 1, top + 3);
+			}
+			else
+				WriteTriangle(indices, top, top + 1, top + 3);
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	CylinderMeshSize(int)
+//
+//	segments: vertices around each ring
+//
+//	Return the size of a cylinder: two caps of a center and
+//	a ring, and a side whose first column is repeated at the seam
+///////////////////////////////////////////////////
+GeneratedMeshSize CylinderMeshSize(int segments)
+{
+	GLuint n = (GLuint)segments;
+	return { 2 * (n + 1) + 2 * (n + 1), 2 * 3 * n + 6 * n };
+}
+
+///////////////////////////////////////////////////
+//	GenerateCylinder(int, float, float, GLfloat*, GLuint*)
+//
+//	segments: vertices around each ring
+//	bottomRadius, topRadius: radius at y = 0 and y = 1
+//	vertices, indices: sized with CylinderMeshSize(segments)
+//
+//	Write a cylinder, tapered when the radii differ
+///////////////////////////////////////////////////
+void GenerateCylinder(int segments, float bottomRadius, float topRadius, GLfloat* vertices, GLuint* indices)
+{
+	GLuint ring = (GLuint)segments + 1;
+	WriteCap(segments, bottomRadius, 0.0f, false, 0, vertices, indices);
+	WriteCap(segments, topRadius, 1.0f, true, ring, vertices, indices);
+	WriteSide(segments, bottomRadius, topRadius, 2 * ring, vertices, indices);
+}
+
+///////////////////////////////////////////////////
+//	ConeMeshSize(int)
+//
+//	segments: vertices around the base
+//
+//	Return the size of a cone: a base of a center and a ring,
+//	and a side with its own tip vertex for every column
+///////////////////////////////////////////////////
+GeneratedMeshSize ConeMeshSize(int segments)
+{
+	GLuint n = (GLuint)segments;
+	return { (n + 1) + 2 * (n + 1), 3 * n + 3 * n };
+}
+
+///////////////////////////////////////////////////
+//	GenerateCone(int, GLfloat*, GLuint*)
+//
+//	segments: vertices around the base
+//	vertices, indices: sized with ConeMeshSize(segments)
+//
+//	Write a cone; the tip is split per column so the side is
+//	shaded smoothly around it
+///////////////////////////////////////////////////
+void GenerateCone(int segments, GLfloat* vertices, GLuint* indices)
+{
+	WriteCap(segments, 1.0f, 0.0f, false, 0, vertices, indices);
+	WriteSide(segments, 1.0f, 0.0f, (GLuint)segments + 1, vertices, indices);
+}
+
+///////////////////////////////////////////////////
+//	UVSphereMeshSize(int, int)
+//
+//	slices: columns around y
+//	stacks: rows from pole to pole, at least 2
+//
+//	Return the size of a uv sphere; the seam column and the
+//	poles are repeated so each vertex has its own uv
+///////////////////////////////////////////////////
+GeneratedMeshSize UVSphereMeshSize(int slices, int stacks)
+{
+	return { (GLuint)((slices + 1) * (stacks + 1)), (GLuint)(6 * slices * (stacks - 1)) };
+}
+
+///////////////////////////////////////////////////
+//	GenerateUVSphere(int, int, GLfloat*, GLuint*)
+//
+//	slices: columns around y
+//	stacks: rows from pole to pole, at least 2
+//	vertices, indices: sized with UVSphereMeshSize(slices, stacks)
+//
+//	Write a sphere of latitude rows; the rows at the poles
+//	have one triangle per column
+///////////////////////////////////////////////////
+void GenerateUVSphere(int slices, int stacks, GLfloat* vertices, GLuint* indices)
+{
+	for (int row = 0; row <= stacks; ++row)
+	{
+		float v = (float)row / (float)stacks;
+		float polar = 0.5f * TWO_PI * v;
+		for (int column = 0; column <= slices; ++column)
+		{
+			float u = (float)column / (float)slices;
+			float azimuth = TWO_PI * u;
+			glm::vec3 normal(std::sin(polar) * std::sin(azimuth), std::cos(polar), std::sin(polar) * std::cos(azimuth));
+			WriteVertex(vertices, normal, normal, u, 1.0f - v);
+		}
+	}
+
+	GLuint rowLength = (GLuint)slices + 1;
+	for (int row = 0; row < stacks; ++row)
+	{
+		for (int column = 0; column < slices; ++column)
+		{
+			GLuint upper = row * rowLength + column;
+			GLuint lower = upper + rowLength;
+			if (row != 0)
+				WriteTriangle(indices, upper, lower, upper + 1);
+			if (row != stacks - 1)
+				WriteTriangle(indices, upper + 1, lower, lower + 1);
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	IcosphereMeshSize(int)
+//
+//	frequency: parts each icosahedron edge is split into
+//
+//	Return the size of an icosphere; every face has its own
+//	triangular grid of vertices
+///////////////////////////////////////////////////
+GeneratedMeshSize IcosphereMeshSize(int frequency)
+{
+	GLuint n = (GLuint)frequency;
+	return { 20 * (n + 1) * (n + 2) / 2, 20 * 3 * n * n };
+}
+
+///////////////////////////////////////////////////
+//	GenerateIcosphere(int, GLfloat*, GLuint*)
+//
+//	frequency: parts each icosahedron edge is split into
+//	vertices, indices: sized with IcosphereMeshSize(frequency)
+//
+//	Write a geodesic sphere. The faces are tessellated on
+//	their own, without an edge table to share vertices, so
+//	the vertices along the icosahedron edges are repeated
+///////////////////////////////////////////////////
+void GenerateIcosphere(int frequency, GLfloat* vertices, GLuint* indices)
+{
+	GLuint faceFirst = 0;
+	for (const int* face : ICOSAHEDRON_FACES)
+	{
+		glm::vec3 a = ICOSAHEDRON_CORNERS[face[0]];
+		glm::vec3 ab = (ICOSAHEDRON_CORNERS[face[1]] - a) / (float)frequency;
+		glm::vec3 ac = (ICOSAHEDRON_CORNERS[face[2]] - a) / (float)frequency;
+
+		// row i holds frequency + 1 - i points, from the a-b edge toward c
+		for (int i = 0; i <= frequency; ++i)
+		{
+			for (int j = 0; i + j <= frequency; ++j)
+			{
+				glm::vec3 normal = glm::normalize(a + ab * (float)j + ac * (float)i);
+				float u, v;
+				SphereUV(normal, u, v);
+				WriteVertex(vertices, normal, normal, u, v);
+			}
+		}
+
+		GLuint rowFirst = faceFirst;
+		for (int i = 0; i < frequency; ++i)
+		{
+			GLuint rowLength = frequency + 1 - i;
+			GLuint nextFirst = rowFirst + rowLength;
+			for (GLuint j = 0; j + 1 < rowLength; ++j)
+			{
+				WriteTriangle(indices, rowFirst + j, rowFirst + j + 1, nextFirst + j);
+				if (j + 2 < rowLength)
+					WriteTriangle(indices, rowFirst + j + 1, nextFirst + j + 1, nextFirst + j);
+			}
+			rowFirst = nextFirst;
+		}
+
+		faceFirst += (frequency + 1) * (frequency + 2) / 2;
+	}
+}
+
+///////////////////////////////////////////////////
+//	TorusMeshSize(int, int)
+//
+//	mainSegments: vertices around the ring
+//	tubeSegments: vertices around the tube
+//
+//	Return the size of a torus; the first ring and the first
+//	tube column are repeated so the uvs close at the seams
+///////////////////////////////////////////////////
+GeneratedMeshSize TorusMeshSize(int mainSegments, int tubeSegments)
+{
+	return { (GLuint)((mainSegments + 1) * (tubeSegments + 1)), (GLuint)(6 * mainSegments * tubeSegments) };
+}
+
+///////////////////////////////////////////////////
+//	GenerateTorus(int, int, float, float, GLfloat*, GLuint*)
+//
+//	mainSegments: vertices around the ring
+//	tubeSegments: vertices around the tube
+//	mainRadius: from the center to the middle of the tube
+//	tubeRadius: radius of the tube
+//	vertices, indices: sized with TorusMeshSize(mainSegments, tubeSegments)
+//
+//	Write a closed torus, each surface point shared by the
+//	triangles around it
+///////////////////////////////////////////////////
+void GenerateTorus(int mainSegments, int tubeSegments, float mainRadius, float tubeRadius, GLfloat* vertices, GLuint* indices)
+{
+	for (int i = 0; i <= mainSegments; ++i)
+	{
+		float u = (float)i / (float)mainSegments;
+		float cosMain = std::cos(TWO_PI * u);
+		float sinMain = std::sin(TWO_PI * u);
+		for (int j = 0; j <= tubeSegments; ++j)
+		{
+			float v = (float)j / (float)tubeSegments;
+			float cosTube = std::cos(TWO_PI * v);
+			float sinTube = std::sin(TWO_PI * v);
+			glm::vec3 normal(cosTube * cosMain, cosTube * sinMain, sinTube);
+			glm::vec3 position(mainRadius * cosMain, mainRadius * sinMain, 0.0f);
+			WriteVertex(vertices, position + tubeRadius * normal, normal, u, v);
+		}
+	}
+
+	GLuint ringLength = (GLuint)tubeSegments + 1;
+	for (int i = 0; i < mainSegments; ++i)
+	{
+		for (int j = 0; j < tubeSegments; ++j)
+		{
+			GLuint current = i * ringLength + j;
+			GLuint next = current + ringLength;
+			WriteTriangle(indices, current, next, current + 1);
+			WriteTriangle(indices, current + 1, next, next + 1);
+		}
+	}
+}
+
+///////////////////////////////////////////////////
+//	BoxMeshSize(int)
+//
+//	subdivisions: quads along each edge of a face
+//
+//	Return the size of a box; every face has its own grid of
+//	vertices, so the normals stay sharp at the edges
+///////////////////////////////////////////////////
+GeneratedMeshSize BoxMeshSize(int subdivisions)
+{
+	GLuint n = (GLuint)subdivisions;
+	return { 6 * (n + 1) * (n + 1), 6 * 6 * n * n };
+}
+
+///////////////////////////////////////////////////
+//	GenerateBox(int, GLfloat*, GLuint*)
+//
+//	subdivisions: quads along each edge of a face
+//	vertices, indices: sized with BoxMeshSize(subdivisions)
+//
+//	Write a unit cube; each face is mapped to the whole texture
+///////////////////////////////////////////////////
+void GenerateBox(int subdivisions, GLfloat* vertices, GLuint* indices)
+{
+	GLuint rowLength = (GLuint)subdivisions + 1;
+	GLuint faceFirst = 0;
+	for (const glm::vec3* face : BOX_FACES)
+	{
+		const glm::vec3& normal = face[0];
+		for (int row = 0; row <= subdivisions; ++row)
+		{
+			float v = (float)row / (float)subdivisions;
+			for (int column = 0; column <= subdivisions; ++column)
+			{
+				float u = (float)column / (float)subdivisions;
+				WriteVertex(vertices, 0.5f * normal + (u - 0.5f) * face[1] + (v - 0.5f) * face[2], normal, u, v);
+			}
+		}
+
+		for (int row = 0; row < subdivisions; ++row)
+		{
+			for (int column = 0; column < subdivisions; ++column)
+			{
+				GLuint lower = faceFirst + row * rowLength + column;
+				GLuint upper = lower + rowLength;
+				WriteTriangle(indices, lower, lower + 1, upper + 1);
+				WriteTriangle(indices, lower, upper + 1, upper);
+			}
+		}
+
+		faceFirst += rowLength * rowLength;
+	}
+}
@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshgenerator.h
+// ========
+// parametric primitives: cylinder, cone, sphere, icosphere, torus, box
+//
+// Each primitive has a size function, which tells how many vertices and
+// indices a tessellation needs, and a generate function, which writes them
+// into buffers the caller sized with it. Nothing is allocated while
+// generating, so a level of detail or a dense test mesh costs no more than
+// its own vertices. Vertices are interleaved position, normal and texture
+// coordinates like in Meshes; indices start at 0 for the first vertex written.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+// position, normal, uv
+const GLuint GENERATED_FLOATS_PER_VERTEX = 8;
+
+struct GeneratedMeshSize
+{
+	GLuint nVertices;
+	GLuint nIndices;
+};
+
+// Cylinder along y from 0 to 1, the radius narrows from bottomRadius to topRadius, which is
+// above 0; a cone has its own generator. Triangles
+GeneratedMeshSize CylinderMeshSize(int segments);
+void GenerateCylinder(int segments, float bottomRadius, float topRadius, GLfloat* vertices, GLuint* indices);
+
+// Cone along y from its base of radius 1 at 0 to its tip at 1. Triangles
+GeneratedMeshSize ConeMeshSize(int segments);
+void GenerateCone(int segments, GLfloat* vertices, GLuint* indices);
+
+// Sphere of radius 1 around the origin; slices around y, stacks from pole to pole (at least 2). Triangles
+GeneratedMeshSize UVSphereMeshSize(int slices, int stacks);
+void GenerateUVSphere(int slices, int stacks, GLfloat* vertices, GLuint* indices);
+
+// Icosahedron whose edges are split into `frequency` parts, pushed out to radius 1. Triangles
+GeneratedMeshSize IcosphereMeshSize(int frequency);
+void GenerateIcosphere(int frequency, GLfloat* vertices, GLuint* indices);
+
+// Torus around z: a ring of mainRadius in the xy plane, swept by a tube of tubeRadius. Triangles
+GeneratedMeshSize TorusMeshSize(int mainSegments, int tubeSegments);
+void GenerateTorus(int mainSegments, int tubeSegments, float mainRadius, float tubeRadius, GLfloat* vertices, GLuint* indices);
+
+// Unit cube around the origin, every face split into subdivisions x subdivisions quads. Triangles
+GeneratedMeshSize BoxMeshSize(int subdivisions);
+void GenerateBox(int subdivisions, GLfloat* vertices, GLuint* indices);
@@ -0,0 +1,428 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimize.cpp
+// ========
+// reorder indexed triangle meshes for the post-transform vertex cache,
+// overdraw and vertex fetch
+///////////////////////////////////////////////////////////////////////////////
+
+#include "meshoptimize.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	const GLuint NO_VERTEX = 0xffffffffu;
+
+	// FIFO post-transform cache: a vertex stays cached until cacheSize newer vertices went in
+	class FifoCache
+	{
+	public:
+		FifoCache(GLuint nVertices, int cacheSize) : missTime(nVertices, -cacheSize), cacheSize(cacheSize) {}
+
+		// Return true if the vertex had to be transformed
+		bool Use(GLuint vertex)
+		{
+			if (clock - missTime[vertex] < cacheSize)
+				return false;
+			missTime[vertex] = clock++;
+			++nMisses;
+			return true;
+		}
+
+		// Empty the cache
+		void Flush()
+		{
+			clock += cacheSize;
+		}
+
+		int nMisses = 0;
+
+	private:
+		std::vector<int> missTime;
+		int clock = 0;
+		int cacheSize;
+	};
+
+	glm::vec3 Position(const GLfloat* vertices, GLuint stride, GLuint vertex)
+	{
+		const GLfloat* position = vertices + vertex * stride;
+		return glm::vec3(position[0], position[1], position[2]);
+	}
+
+	// Next vertex to fan around after a dead end: a recent vertex with triangles left, or else the first such vertex
+	int SkipDeadEnd(const std::vector<int>& live, std::vector<GLuint>& deadEnd, GLuint& cursor, GLuint nVertices)
+	{
+		while (!deadEnd.empty())
+		{
+			GLuint vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (live[vertex] > 0)
+				return (int)vertex;
+		}
+
+		for (; cursor < nVertices; ++cursor)
+		{
+			if (live[cursor] > 0)
+				return (int)cursor;
+		}
+		return -1;
+	}
+}
+
+///////////////////////////////////////////////////
+//	MeasureVertexCache(const GLuint*, GLuint, GLuint, int)
+//
+//	indices: triangle list
+//	nIndices: number of indices
+//	nVertices: number of vertices the indices refer to
+//	cacheSize: entries of the simulated FIFO cache
+//
+//	Return how often the vertices of the triangle list would
+//	be transformed, per triangle and per vertex used
+///////////////////////////////////////////////////
+VertexCacheStats MeasureVertexCache(const GLuint* indices, GLuint nIndices, GLuint nVertices, int cacheSize)
+{
+	FifoCache cache(nVertices, cacheSize);
+	std::vector<bool> used(nVertices, false);
+	GLuint nUsed = 0;
+	for (GLuint i = 0; i < nIndices; ++i)
+	{
+		cache.Use(indices[i]);
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			++nUsed;
+		}
+	}
+
+	VertexCacheStats stats = { 0.0f, 0.0f };
+	if (nIndices >= 3)
+		stats.acmr = (float)cache.nMisses / (float)(nIndices / 3);
+	if (nUsed > 0)
+		stats.atvr = (float)cache.nMisses / (float)nUsed;
+	return stats;
+}
+
+///////////////////////////////////////////////////
+//	OptimizeVertexCache(GLuint*, GLuint, GLuint, int, std::vector<GLuint>&)
+//
+//	indices: triangle list, reordered in place
+//	nIndices: number of indices
+//	nVertices: number of vertices the indices refer to
+//	cacheSize: entries of the cache to order for
+//	clusters: receives the first index of every cluster
+//
+//	Tipsify: emit every remaining triangle around a fanning
+//	vertex, then fan next around the vertex just used that
+//	will still be cached with its remaining triangles, if
+//	any. When none is left, a dead end, the search restarts
+//	from a recently used vertex and a new cluster begins
+///////////////////////////////////////////////////
+void OptimizeVertexCache(GLuint* indices, GLuint nIndices, GLuint nVertices, int cacheSize, std::vector<GLuint>& clusters)
+{
+	GLuint nTriangles = nIndices / 3;
+	clusters.clear();
+	if (nTriangles == 0)
+		return;
+
+	// triangles around every vertex
+	std::vector<GLuint> adjacencyFirst(nVertices + 1, 0);
+	for (GLuint i = 0; i < nTriangles * 3; ++i)
+		++adjacencyFirst[indices[i] + 1];
+	for (GLuint v = 0; v < nVertices; ++v)
+		adjacencyFirst[v + 1] += adjacencyFirst[v];
+
+	std::vector<GLuint> adjacency(nTriangles * 3);
+	std::vector<GLuint> fill(adjacencyFirst.begin(), adjacencyFirst.end() - 1);
+	for (GLuint i = 0; i < nTriangles * 3; ++i)
+		adjacency[fill[indices[i]]++] = i / 3;
+
+	// triangles not yet emitted around every vertex
+	std::vector<int> live(nVertices);
+	for (GLuint v = 0; v < nVertices; ++v)
+		live[v] = (int)(adjacencyFirst[v + 1] - adjacencyFirst[v]);
+
+	std::vector<int> cacheTime(nVertices, 0);
+	int time = cacheSize + 1;
+	std::vector<bool> emitted(nTriangles, false);
+	std::vector<GLuint> deadEnd;
+	std::vector<GLuint> candidates;
+	std::vector<GLuint> output;
+	output.reserve(nTriangles * 3);
+
+	GLuint cursor = 0;
+	bool clusterEnded = true;
+	int fanning = SkipDeadEnd(live, deadEnd, cursor, nVertices);
+	while (fanning >= 0)
+	{
+		candidates.clear();
+		for (GLuint a = adjacencyFirst[fanning]; a < adjacencyFirst[fanning + 1]; ++a)
+		{
+			GLuint triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+
+			if (clusterEnded)
+			{
+				clusters.push_back((GLuint)output.size());
+				clusterEnded = false;
+			}
+
+			for (GLuint k = 0; k < 3; ++k)
+			{
+				GLuint vertex = indices[triangle * 3 + k];
+				output.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				--live[vertex];
+				if (time - cacheTime[vertex] > cacheSize)
+					cacheTime[vertex] = time++;
+			}
+		}
+
+		// prefer the vertex that has been in the cache longest but will still be there after its own triangles
+		int best = -1;
+		int bestPriority = -1;
+		for (GLuint vertex : candidates)
+		{
+			if (live[vertex] <= 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[vertex] + 2 * live[vertex] <= cacheSize)
+				priority = time - cacheTime[vertex];
+			if (priority > bestPriority)
+			{
+				best = (int)vertex;
+				bestPriority = priority;
+			}
+		}
+
+		if (best < 0)
+		{
+			best = SkipDeadEnd(live, deadEnd, cursor, nVertices);
+			clusterEnded = true;
+		}
+		fanning = best;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+///////////////////////////////////////////////////
+//	OptimizeOverdraw(GLuint*, GLuint, const GLfloat*, GLuint, GLuint, int, float, std::vector<GLuint>&)
+//
+//	indices: triangle list ordered by OptimizeVertexCache(), reordered in place
+//	nIndices: number of indices
+//	vertices: vertex data starting with a position
+//	nVertices: number of vertices
+//	stride: floats from one vertex to the next
+//	cacheSize: entries of the cache the triangles were ordered for
+//	threshold: cache ratio a split cluster may reach, relative to the whole mesh
+//	clusters: first index of every cluster; receives the clusters in their new order
+//
+//	Split every cluster where its triangles so far, started
+//	with an empty cache, reach the cache ratio of the mesh
+//	times threshold; a last piece that never gets there is
+//	merged back into the one before it. Then sort the clusters by how far they
+//	face out from the mesh center: from most views those are
+//	in front of the rest, so drawing them first lets the
+//	depth test reject more of what follows
+///////////////////////////////////////////////////
+void OptimizeOverdraw(GLuint* indices, GLuint nIndices, const GLfloat* vertices, GLuint nVertices, GLuint stride,
+	int cacheSize, float threshold, std::vector<GLuint>& clusters)
+{
+	GLuint nTriangles = nIndices / 3;
+	if (nTriangles == 0 || clusters.empty())
+		return;
+
+	float splitRatio = MeasureVertexCache(indices, nTriangles * 3, nVertices, cacheSize).acmr * threshold;
+
+	// soft boundaries inside the clusters of the cache pass
+	std::vector<GLuint> split;
+	FifoCache cache(nVertices, cacheSize);
+	for (std::size_t c = 0; c < clusters.size(); ++c)
+	{
+		GLuint end = c + 1 < clusters.size() ? clusters[c + 1] : nTriangles * 3;
+		GLuint start = clusters[c];
+		split.push_back(start);
+		cache.Flush();
+		int missesAtStart = cache.nMisses;
+		for (GLuint i = start; i < end; i += 3)
+		{
+			cache.Use(indices[i]);
+			cache.Use(indices[i + 1]);
+			cache.Use(indices[i + 2]);
+
+			GLuint next = i + 3;
+			float ratio = (float)(cache.nMisses - missesAtStart) / (float)((next - start) / 3);
+			if (next < end && ratio <= splitRatio)
+			{
+				split.push_back(next);
+				start = next;
+				cache.Flush();
+				missesAtStart = cache.nMisses;
+			}
+		}
+
+		// the tail of the cluster starts cold too, but unlike the pieces before it nothing bounds its ratio
+		if (start != clusters[c] && start < end)
+		{
+			float ratio = (float)(cache.nMisses - missesAtStart) / (float)((end - start) / 3);
+			if (ratio > splitRatio)
+				split.pop_back();
+		}
+	}
+
+	// area weighted center and facing of the mesh and of every cluster
+	struct Cluster
+	{
+		GLuint first;
+		GLuint end;
+		float facing;
+	};
+	std::vector<Cluster> pieces(split.size());
+	std::vector<glm::vec3> centers(split.size());
+	std::vector<glm::vec3> normals(split.size());
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (std::size_t c = 0; c < split.size(); ++c)
+	{
+		pieces[c].first = split[c];
+		pieces[c].end = c + 1 < split.size() ? split[c + 1] : nTriangles * 3;
+
+		glm::vec3 center(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (GLuint i = pieces[c].first; i < pieces[c].end; i += 3)
+		{
+			glm::vec3 p0 = Position(vertices, stride, indices[i]);
+			glm::vec3 p1 = Position(vertices, stride, indices[i + 1]);
+			glm::vec3 p2 = Position(vertices, stride, indices[i + 2]);
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+
+		meshCenter += center;
+		meshArea += area;
+		centers[c] = area > 0.0f ? center / area : Position(vertices, stride, indices[pieces[c].first]);
+		normals[c] = normal;
+	}
+	if (meshArea > 0.0f)
+		meshCenter /= meshArea;
+
+	for (std::size_t c = 0; c < pieces.size(); ++c)
+	{
+		float length = glm::length(normals[c]);
+		pieces[c].facing = length > 0.0f ? glm::dot(centers[c] - meshCenter, normals[c] / length) : 0.0f;
+	}
+
+	std::stable_sort(pieces.begin(), pieces.end(),
+		[](const Cluster& a, const Cluster& b)
+		{
+			return a.facing > b.facing;
+		});
+
+	std::vector<GLuint> ordered;
+	ordered.reserve(nTriangles * 3);
+	clusters.clear();
+	for (const Cluster& piece : pieces)
+	{
+		clusters.push_back((GLuint)ordered.size());
+		ordered.insert(ordered.end(), indices + piece.first, indices + piece.end);
+	}
+	std::copy(ordered.begin(), ordered.end(), indices);
+}
+
+///////////////////////////////////////////////////
+//	OptimizeVertexFetch(GLfloat*, GLuint, GLuint, GLuint*, GLuint)
+//
+//	vertices: vertex data, reordered in place
+//	nVertices: number of vertices
+//	stride: floats from one vertex to the next
+//	indices: triangle list, renumbered in place
+//	nIndices: number of indices
+//
+//	Number the vertices in the order the triangles first use
+//	them and move their data to match
+///////////////////////////////////////////////////
+void OptimizeVertexFetch(GLfloat* vertices, GLuint nVertices, GLuint stride, GLuint* indices, GLuint nIndices)
+{
+	std::vector<GLuint> remap(nVertices, NO_VERTEX);
+	GLuint next = 0;
+	for (GLuint i = 0; i < nIndices; ++i)
+	{
+		GLuint& vertex = remap[indices[i]];
+		if (vertex == NO_VERTEX)
+			vertex = next++;
+		indices[i] = vertex;
+	}
+	for (GLuint v = 0; v < nVertices; ++v)
+	{
+		if (remap[v] == NO_VERTEX)
+			remap[v] = next++;
+	}
+
+	std::vector<GLfloat> original(vertices, vertices + nVertices * stride);
+	for (GLuint v = 0; v < nVertices; ++v)
+		std::memcpy(vertices + remap[v] * stride, original.data() + v * stride, sizeof(GLfloat) * stride);
+}
+
+///////////////////////////////////////////////////
+//	OptimizeMesh(GLuint*, GLuint, GLfloat*, GLuint, GLuint)
+//
+//	indices: triangle list, reordered in place
+//	nIndices: number of indices
+//	vertices: vertex data starting with a position, reordered in place
+//	nVertices: number of vertices
+//	stride: floats from one vertex to the next
+//
+//	Run the cache, overdraw and fetch passes. Overdraw trades
+//	some cache hits for fewer hidden pixels; when the mesh ends
+//	up more than OPTIMIZE_FALLBACK_THRESHOLD times worse than it came in,
+//	fall back to the cache order, or to the input order if the
+//	cache pass did not help either
+///////////////////////////////////////////////////
+MeshOptimizeResult OptimizeMesh(GLuint* indices, GLuint nIndices, GLfloat* vertices, GLuint nVertices, GLuint stride)
+{
+	MeshOptimizeResult result;
+	result.before = MeasureVertexCache(indices, nIndices, nVertices, VERTEX_CACHE_SIZE);
+
+	std::vector<GLuint> input(indices, indices + nIndices);
+	std::vector<GLuint> clusters;
+	OptimizeVertexCache(indices, nIndices, nVertices, VERTEX_CACHE_SIZE, clusters);
+	float cacheRatio = MeasureVertexCache(indices, nIndices, nVertices, VERTEX_CACHE_SIZE).acmr;
+
+	std::vector<GLuint> cacheOrder(indices, indices + nIndices);
+	OptimizeOverdraw(indices, nIndices, vertices, nVertices, stride, VERTEX_CACHE_SIZE, OVERDRAW_SPLIT_THRESHOLD, clusters);
+	float overdrawRatio = MeasureVertexCache(indices, nIndices, nVertices, VERTEX_CACHE_SIZE).acmr;
+
+	result.order = MESH_ORDER_OVERDRAW;
+	result.nClusters = (GLuint)clusters.size();
+	if (overdrawRatio > result.before.acmr * OPTIMIZE_FALLBACK_THRESHOLD)
+	{
+		result.nClusters = 0;
+		if (cacheRatio < result.before.acmr)
+		{
+			result.order = MESH_ORDER_VERTEX_CACHE;
+			std::copy(cacheOrder.begin(), cacheOrder.end(), indices);
+		}
+		else
+		{
+			result.order = MESH_ORDER_INPUT;
+			std::copy(input.begin(), input.end(), indices);
+		}
+	}
+
+	// renumbering the vertices leaves the cache ratios as they are
+	OptimizeVertexFetch(vertices, nVertices, stride, indices, nIndices);
+	result.after = MeasureVertexCache(indices, nIndices, nVertices, VERTEX_CACHE_SIZE);
+	return result;
+}
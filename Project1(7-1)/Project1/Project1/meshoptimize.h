@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// meshoptimize.h
+// ========
+// reorder indexed triangle meshes for the post-transform vertex cache,
+// overdraw and vertex fetch
+//
+// OptimizeVertexCache() orders the triangles with Tipsify (Sander, Nehab and
+// Barczak 2007), which fans around recently used vertices and also splits
+// the result into clusters. OptimizeOverdraw() then orders the clusters so
+// the ones facing away from the mesh center, likely to hide the others, are
+// drawn first. OptimizeVertexFetch() finally renumbers the vertices in the
+// order the triangles use them, so vertex reads walk the buffer forward.
+// Cache behaviour is measured with a FIFO cache of the given size.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <vector>
+
+// Cache size the meshes are ordered and measured for; small enough to hold on any GPU
+const int VERTEX_CACHE_SIZE = 16;
+
+// How much worse than the whole mesh a cluster's cache ratio may get when it is split for overdraw
+const float OVERDRAW_SPLIT_THRESHOLD = 1.05f;
+
+// How much worse than the input order the optimized mesh's cache ratio may get before OptimizeMesh() falls back
+const float OPTIMIZE_FALLBACK_THRESHOLD = 1.05f;
+
+struct VertexCacheStats
+{
+	float acmr;     // average cache miss ratio: vertices transformed per triangle, 0.5 at best
+	float atvr;     // average transform to vertex ratio: vertices transformed per vertex, 1 at best
+};
+
+VertexCacheStats MeasureVertexCache(const GLuint* indices, GLuint nIndices, GLuint nVertices, int cacheSize);
+
+// Reorder the triangles; clusters receives the first index of every cluster
+void OptimizeVertexCache(GLuint* indices, GLuint nIndices, GLuint nVertices, int cacheSize, std::vector<GLuint>& clusters);
+
+// Split the clusters found by OptimizeVertexCache() where the cache has warmed up to within threshold
+// times the mesh's ACMR, then reorder them; vertices start with a position, stride floats apart
+void OptimizeOverdraw(GLuint* indices, GLuint nIndices, const GLfloat* vertices, GLuint nVertices, GLuint stride,
+	int cacheSize, float threshold, std::vector<GLuint>& clusters);
+
+// Renumber the vertices in order of first use, moving their data along; unused vertices go last
+void OptimizeVertexFetch(GLfloat* vertices, GLuint nVertices, GLuint stride, GLuint* indices, GLuint nIndices);
+
+// Triangle order OptimizeMesh() kept
+enum MeshOrder
+{
+	MESH_ORDER_INPUT,           // neither pass beat the order the mesh came in
+	MESH_ORDER_VERTEX_CACHE,    // the overdraw pass cost too many cache hits
+	MESH_ORDER_OVERDRAW         // both passes
+};
+
+struct MeshOptimizeResult
+{
+	VertexCacheStats before;
+	VertexCacheStats after;
+	MeshOrder order;
+	GLuint nClusters;           // clusters drawn in overdraw order, 0 unless that order was kept
+};
+
+// All three passes, keeping the overdraw order only while the ACMR stays within OPTIMIZE_FALLBACK_THRESHOLD
+// of the input's; vertices start with a position, stride floats apart
+MeshOptimizeResult OptimizeMesh(GLuint* indices, GLuint nIndices, GLfloat* vertices, GLuint nVertices, GLuint stride);
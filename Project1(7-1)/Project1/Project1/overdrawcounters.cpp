@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+// overdrawcounters.cpp
+// ========
+// GPU counters of how many fragments the shading pass runs per pixel
+///////////////////////////////////////////////////////////////////////////////
+
+#include "overdrawcounters.h"
+
+///////////////////////////////////////////////////
+//	Create()
+//
+//	Create one pair of queries per frame in flight
+///////////////////////////////////////////////////
+void OverdrawCounters::Create()
+{
+	glGenQueries(LATENCY, invocationQueries);
+	glGenQueries(LATENCY, samplesQueries);
+	for (int& size : queryPixels)
+		size = 0;
+	frame = 0;
+}
+
+///////////////////////////////////////////////////
+//	Begin(int, int)
+//
+//	width, height: size of the framebuffer the pass draws to
+//
+//	Read the results of the queries issued LATENCY frames
+//	ago, then start counting the pass with them again
+///////////////////////////////////////////////////
+void OverdrawCounters::Begin(int width, int height)
+{
+	int slot = frame % LATENCY;
+	if (queryPixels[slot] > 0)
+	{
+		glGetQueryObjectui64v(invocationQueries[slot], GL_QUERY_RESULT, &fragmentsShaded);
+		glGetQueryObjectui64v(samplesQueries[slot], GL_QUERY_RESULT, &samplesPassed);
+		pixels = queryPixels[slot];
+		overdraw = (float)fragmentsShaded / pixels;
+	}
+
+	queryPixels[slot] = width * height;
+	glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, invocationQueries[slot]);
+	glBeginQuery(GL_SAMPLES_PASSED, samplesQueries[slot]);
+}
+
+///////////////////////////////////////////////////
+//	End()
+//
+//	Stop counting the pass started by Begin()
+///////////////////////////////////////////////////
+void OverdrawCounters::End()
+{
+	glEndQuery(GL_SAMPLES_PASSED);
+	glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+	++frame;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Release the queries
+///////////////////////////////////////////////////
+void OverdrawCounters::Destroy()
+{
+	glDeleteQueries(LATENCY, invocationQueries);
+	glDeleteQueries(LATENCY, samplesQueries);
+	for (int& size : queryPixels)
+		size = 0;
+}
@@ -0,0 +1,36 @@
+///////////////////////////////////////////////////////////////////////////////
+// overdrawcounters.h
+// ========
+// GPU counters of how many fragments the shading pass runs per pixel
+//
+// The pass is wrapped in a fragment shader invocation query and a samples
+// passed query. Their results are read a few frames later, when the GPU has
+// long finished with them, so measuring never makes the CPU wait.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+class OverdrawCounters
+{
+public:
+	static const int LATENCY = 3;   // frames between issuing the queries and reading them
+
+	GLuint invocationQueries[LATENCY] = {};
+	GLuint samplesQueries[LATENCY] = {};
+	int queryPixels[LATENCY] = {};  // framebuffer size each query pair was issued for, 0 when not issued
+	int frame = 0;
+
+	// Results of the most recent frame read back
+	GLuint64 fragmentsShaded = 0;   // fragment shader invocations
+	GLuint64 samplesPassed = 0;     // samples that passed the depth test
+	int pixels = 0;
+	float overdraw = 0.0f;          // fragments shaded per pixel
+
+public:
+	void Create();
+	void Begin(int width, int height);
+	void End();
+	void Destroy();
+};
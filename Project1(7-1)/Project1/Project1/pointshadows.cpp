@@ -0,0 +1,329 @@
+///////////////////////////////////////////////////////////////////////////////
+// pointshadows.cpp
+// ========
+// cached cube shadow maps for the point lights, redrawn under a budget
+///////////////////////////////////////////////////////////////////////////////
+
+#include "pointshadows.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	const unsigned int ALL_FACES = 0x3f;
+
+	// view directions and up vectors of the cube faces, in the order of the
+	// GL_TEXTURE_CUBE_MAP_POSITIVE_X... targets so sampling finds the same texels
+	const glm::vec3 FACE_DIRECTIONS[6] =
+	{
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+		glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+	};
+	const glm::vec3 FACE_UPS[6] =
+	{
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+	};
+
+	///////////////////////////////////////////////////
+	//	SphereInFrustum(const Frustum&, const glm::vec3&, float)
+	//
+	//	Whether a sphere is at least partly inside the frustum
+	///////////////////////////////////////////////////
+	bool SphereInFrustum(const Frustum& frustum, const glm::vec3& center, float radius)
+	{
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////
+	//	BoxInFrustum(const Frustum&, const glm::vec3&, const glm::vec3&)
+	//
+	//	Whether a box is at least partly inside the frustum,
+	//	testing the corner furthest along each plane normal
+	///////////////////////////////////////////////////
+	bool BoxInFrustum(const Frustum& frustum, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			glm::vec3 corner(plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+				plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+				plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f)
+				return false;
+		}
+		return true;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Create()
+//
+//	Create the depth cube map array and the framebuffer
+//	its faces are drawn through; return false when the
+//	framebuffer is not complete
+///////////////////////////////////////////////////
+bool PointShadowMaps::Create()
+{
+	for (PointShadowSlot& slot : slots)
+	{
+		slot.light = -1;
+		slot.dirtyFaces = ALL_FACES;
+		slot.complete = false;
+	}
+
+	// the faces store distance to the light over its radius, 16 bits are plenty
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, depthTexture);
+	glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 1, GL_DEPTH_COMPONENT16, FACE_SIZE, FACE_SIZE, SLOT_COUNT * 6);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::POINT_SHADOW::INCOMPLETE_FRAMEBUFFER 0x" << std::hex << status << std::dec << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	Update(std::vector<PointLight>&, const std::vector<SceneLight>&, const glm::vec3&,
+//		const Frustum&, bool, const glm::vec3&, const glm::vec3&)
+//
+//	lights: lights of the frame, receive the slot to sample
+//	sceneLights: scene lights the frame's lights come from, same order
+//	cameraPosition, cameraFrustum: where the frame is seen from
+//	sceneMoved: whether objects moved since the last update
+//	movedMin, movedMax: box around the old and new places of those objects
+//
+//	Hand the slots to the nearest visible shadowed lights,
+//	flag the faces that a moving light or object made stale
+//	and fill faceUpdates with as many of them as the budget
+//	allows, lights that moved first. A light samples its slot
+//	once all six faces are drawn for where it is, and casts no
+//	shadow until then
+///////////////////////////////////////////////////
+void PointShadowMaps::Update(std::vector<PointLight>& lights, const std::vector<SceneLight>& sceneLights,
+	const glm::vec3& cameraPosition, const Frustum& cameraFrustum,
+	bool sceneMoved, const glm::vec3& movedMin, const glm::vec3& movedMax)
+{
+	std::vector<int> order;
+	AssignSlots(lights, sceneLights, cameraPosition, cameraFrustum, order);
+
+	for (int index : order)
+	{
+		PointShadowSlot& slot = slots[index];
+		const PointLight& light = lights[slot.light];
+		float nearPlane = sceneLights[slot.light].shadowNear;
+
+		if (light.position != slot.position || light.radius != slot.radius || nearPlane != slot.nearPlane)
+		{
+			// faces drawn for the old position or range would compare against the wrong distances
+			FitFaces(slot, light, nearPlane);
+			slot.dirtyFaces = ALL_FACES;
+			slot.complete = false;
+		}
+		else if (sceneMoved && slot.dirtyFaces != ALL_FACES)
+		{
+			glm::vec3 closest = glm::clamp(light.position, movedMin, movedMax);
+			if (glm::length(closest - light.position) > light.radius)
+				continue;
+
+			for (int face = 0; face < 6; ++face)
+			{
+				if (BoxInFrustum(ExtractFrustum(slot.faceViewProjection[face]), movedMin, movedMax))
+					slot.dirtyFaces |= 1u << face;
+			}
+		}
+	}
+
+	// lights without a shadow first, so a moving light gets its cube back as soon as the budget
+	// allows, then nearest lights first; faces over the budget stay dirty for the next frames
+	std::stable_partition(order.begin(), order.end(),
+		[this](int index)
+		{
+			return !slots[index].complete;
+		});
+
+	faceUpdates.clear();
+	nFacesPending = 0;
+	for (int index : order)
+	{
+		PointShadowSlot& slot = slots[index];
+		for (int face = 0; face < 6; ++face)
+		{
+			if (!(slot.dirtyFaces & (1u << face)))
+				continue;
+
+			if ((int)faceUpdates.size() == FACE_BUDGET)
+			{
+				++nFacesPending;
+				continue;
+			}
+
+			PointShadowFace update;
+			update.slot = index;
+			update.face = face;
+			update.viewProjection = slot.faceViewProjection[face];
+			update.lightPosition = slot.position;
+			update.lightRadius = slot.radius;
+			faceUpdates.push_back(update);
+			slot.dirtyFaces &= ~(1u << face);
+		}
+
+		if (slot.dirtyFaces == 0)
+			slot.complete = true;
+	}
+	nFacesDrawn += (int)faceUpdates.size();
+
+	for (PointLight& light : lights)
+		light.shadowSlot = -1;
+	for (int index : order)
+	{
+		if (slots[index].complete)
+			lights[slots[index].light].shadowSlot = index;
+	}
+}
+
+///////////////////////////////////////////////////
+//	BeginFace(const PointShadowFace&, RenderStateCache&)
+//
+//	Direct drawing into a cube face of a slot and clear it;
+//	the caller restores the framebuffer and viewport
+///////////////////////////////////////////////////
+void PointShadowMaps::BeginFace(const PointShadowFace& face, RenderStateCache& state) const
+{
+	state.BindFramebuffer(fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, face.slot * 6 + face.face);
+	glViewport(0, 0, FACE_SIZE, FACE_SIZE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+///////////////////////////////////////////////////
+//	BindTexture(RenderStateCache&)
+//
+//	Bind the cube map array on the unit the shaders sample
+///////////////////////////////////////////////////
+void PointShadowMaps::BindTexture(RenderStateCache& state) const
+{
+	state.BindTexture(POINT_SHADOW_MAP_UNIT, GL_TEXTURE_CUBE_MAP_ARRAY, depthTexture);
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Release the depth texture and framebuffer
+///////////////////////////////////////////////////
+void PointShadowMaps::Destroy()
+{
+	glDeleteTextures(1, &depthTexture);
+	glDeleteFramebuffers(1, &fbo);
+	depthTexture = 0;
+	fbo = 0;
+}
+
+///////////////////////////////////////////////////
+//	AssignSlots(const std::vector<PointLight>&, const std::vector<SceneLight>&,
+//		const glm::vec3&, const Frustum&, std::vector<int>&)
+//
+//	order: receives the slots in use, nearest light first
+//
+//	Keep the slots of lights that are still among the
+//	nearest visible ones and give the freed slots to the
+//	lights that joined them, with every face dirty
+///////////////////////////////////////////////////
+void PointShadowMaps::AssignSlots(const std::vector<PointLight>& lights, const std::vector<SceneLight>& sceneLights,
+	const glm::vec3& cameraPosition, const Frustum& cameraFrustum, std::vector<int>& order)
+{
+	// shadowed lights reaching into the view, by distance from the camera to their sphere
+	std::vector<std::pair<float, int>> candidates;
+	for (std::size_t i = 0; i < lights.size(); ++i)
+	{
+		float nearPlane = sceneLights[i].shadowNear;
+		if (nearPlane <= 0.0f || nearPlane >= lights[i].radius)
+			continue;
+		if (!SphereInFrustum(cameraFrustum, lights[i].position, lights[i].radius))
+			continue;
+
+		float distance = std::max(0.0f, glm::length(lights[i].position - cameraPosition) - lights[i].radius);
+		candidates.push_back(std::make_pair(distance, (int)i));
+	}
+	std::sort(candidates.begin(), candidates.end());
+	if (candidates.size() > SLOT_COUNT)
+		candidates.resize(SLOT_COUNT);
+
+	std::vector<int> lightSlots(lights.size(), -1);
+	for (const std::pair<float, int>& candidate : candidates)
+		lightSlots[candidate.second] = SLOT_COUNT;
+
+	for (int i = 0; i < SLOT_COUNT; ++i)
+	{
+		PointShadowSlot& slot = slots[i];
+		if (slot.light >= 0 && slot.light < (int)lights.size() && lightSlots[slot.light] == SLOT_COUNT)
+			lightSlots[slot.light] = i;
+		else
+			slot.light = -1;
+	}
+
+	int freeSlot = 0;
+	order.clear();
+	for (const std::pair<float, int>& candidate : candidates)
+	{
+		int light = candidate.second;
+		if (lightSlots[light] == SLOT_COUNT)
+		{
+			while (slots[freeSlot].light >= 0)
+				++freeSlot;
+
+			PointShadowSlot& slot = slots[freeSlot];
+			slot.light = light;
+			slot.dirtyFaces = ALL_FACES;
+			slot.complete = false;
+			FitFaces(slot, lights[light], sceneLights[light].shadowNear);
+			lightSlots[light] = freeSlot;
+		}
+		order.push_back(lightSlots[light]);
+	}
+}
+
+///////////////////////////////////////////////////
+//	FitFaces(PointShadowSlot&, const PointLight&, float)
+//
+//	Build the six 90 degree views of the light, reaching
+//	from the shadow near plane out to its radius
+///////////////////////////////////////////////////
+void PointShadowMaps::FitFaces(PointShadowSlot& slot, const PointLight& light, float nearPlane) const
+{
+	slot.position = light.position;
+	slot.radius = light.radius;
+	slot.nearPlane = nearPlane;
+
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, nearPlane, light.radius);
+	for (int face = 0; face < 6; ++face)
+		slot.faceViewProjection[face] = projection * glm::lookAt(light.position, light.position + FACE_DIRECTIONS[face], FACE_UPS[face]);
+}
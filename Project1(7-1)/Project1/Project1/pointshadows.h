@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// pointshadows.h
+// ========
+// cached cube shadow maps for the point lights, redrawn under a budget
+//
+// Shadowed lights share a fixed number of slots of a depth cube map array,
+// handed to the lights closest to the camera. A slot keeps its six faces
+// until the light moves or a moving object enters one of them, and only
+// the dirty faces are redrawn, a limited number per frame, nearest light
+// first; faces over the budget wait for the next frames.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "frustum.h"
+#include "lightclusters.h"
+#include "renderstate.h"
+#include "scene.h"
+
+// Texture unit the shaders sample the cube maps from, after the sun cascades
+const GLint POINT_SHADOW_MAP_UNIT = 4;
+
+// Slot of the cube map array owned by one light
+struct PointShadowSlot
+{
+	int light;                  // index into the frame's lights, -1 when free
+	glm::vec3 position;         // light the faces were drawn for
+	float radius;
+	float nearPlane;
+	glm::mat4 faceViewProjection[6];
+	unsigned int dirtyFaces;    // one bit per face still to draw
+	bool complete;              // every face drawn for the current position, radius and near plane
+};
+
+// One cube face to draw this frame
+struct PointShadowFace
+{
+	int slot;
+	int face;                   // GL_TEXTURE_CUBE_MAP_POSITIVE_X + face order
+	glm::mat4 viewProjection;
+	glm::vec3 lightPosition;
+	float lightRadius;
+};
+
+class PointShadowMaps
+{
+public:
+	static const int SLOT_COUNT = 32;
+	static const int FACE_SIZE = 256;
+	static const int FACE_BUDGET = 12;      // faces drawn per frame at most
+
+	PointShadowSlot slots[SLOT_COUNT];
+	std::vector<PointShadowFace> faceUpdates;   // faces to draw this frame, nearest light first
+
+	GLuint depthTexture = 0;    // GL_TEXTURE_CUBE_MAP_ARRAY, one cube per slot
+	GLuint fbo = 0;
+
+	// Faces drawn since startup, and faces left dirty by the budget last frame
+	int nFacesDrawn = 0;
+	int nFacesPending = 0;
+
+public:
+	bool Create();
+	void Update(std::vector<PointLight>& lights, const std::vector<SceneLight>& sceneLights,
+		const glm::vec3& cameraPosition, const Frustum& cameraFrustum,
+		bool sceneMoved, const glm::vec3& movedMin, const glm::vec3& movedMax);
+	void BeginFace(const PointShadowFace& face, RenderStateCache& state) const;
+	void BindTexture(RenderStateCache& state) const;
+	void Destroy();
+
+private:
+	void AssignSlots(const std::vector<PointLight>& lights, const std::vector<SceneLight>& sceneLights,
+		const glm::vec3& cameraPosition, const Frustum& cameraFrustum, std::vector<int>& order);
+	void FitFaces(PointShadowSlot& slot, const PointLight& light, float nearPlane) const;
+};
@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendercommands.cpp
+// ========
+// render command packets recorded off the GL thread and executed on it
+///////////////////////////////////////////////////////////////////////////////
+
+#include "rendercommands.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Sort key bits: pass, then draw group slot, then recording order
+	const int PASS_SHIFT = 56;
+	const int SLOT_SHIFT = 32;
+	const std::uint64_t SLOT_MASK = 0xffffff;
+}
+
+///////////////////////////////////////////////////
+//	Clear()
+//
+//	Drop the packets of the last frame, keeping the memory
+///////////////////////////////////////////////////
+void RenderCommandList::Clear()
+{
+	packets.clear();
+	pass = 0;
+	slot = 0;
+	sequence = 0;
+}
+
+///////////////////////////////////////////////////
+//	SetSlot(int, GLuint)
+//
+//	pass: pass the next packets belong to, below 256
+//	slot: position among the draw groups of the pass
+//
+//	Key the next packets; within a slot they keep the
+//	order they are recorded in
+///////////////////////////////////////////////////
+void RenderCommandList::SetSlot(int pass, GLuint slot)
+{
+	this->pass = pass;
+	this->slot = slot;
+	sequence = 0;
+}
+
+///////////////////////////////////////////////////
+//	UseProgram(GLuint)
+//
+//	Record a program change
+///////////////////////////////////////////////////
+void RenderCommandList::UseProgram(GLuint program)
+{
+	Add(RENDER_PACKET_USE_PROGRAM).useProgram = { program };
+}
+
+///////////////////////////////////////////////////
+//	BindTexture(int, GLenum, GLuint)
+//
+//	Record a texture bind on a unit
+///////////////////////////////////////////////////
+void RenderCommandList::BindTexture(int unit, GLenum target, GLuint texture)
+{
+	Add(RENDER_PACKET_BIND_TEXTURE).bindTexture = { unit, target, texture };
+}
+
+///////////////////////////////////////////////////
+//	BindRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr)
+//
+//	Record a glBindBufferRange
+///////////////////////////////////////////////////
+void RenderCommandList::BindRange(GLenum target, GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	Add(RENDER_PACKET_BIND_RANGE).bindRange = { target, binding, buffer, offset, size };
+}
+
+///////////////////////////////////////////////////
+//	SetUniform(GLint, GLuint)
+//
+//	Record a write of an unsigned uniform of the program
+//	current when the packet executes
+///////////////////////////////////////////////////
+void RenderCommandList::SetUniform(GLint location, GLuint value)
+{
+	Add(RENDER_PACKET_UNIFORM_UINT).uniform = { location, value };
+}
+
+///////////////////////////////////////////////////
+//	Draw(GLenum, const void*, GLsizei)
+//
+//	mode: primitive type
+//	indirect: offset of the first command in the indirect buffer
+//	drawCount: number of commands
+//
+//	Record a multi-draw of indexed indirect commands
+///////////////////////////////////////////////////
+void RenderCommandList::Draw(GLenum mode, const void* indirect, GLsizei drawCount)
+{
+	Add(RENDER_PACKET_DRAW).draw = { mode, (GLintptr)indirect, drawCount };
+}
+
+///////////////////////////////////////////////////
+//	SortKey(int, GLuint, GLuint)
+//
+//	Return the key of a packet from its pass, slot and
+//	order within the slot
+///////////////////////////////////////////////////
+std::uint64_t RenderCommandList::SortKey(int pass, GLuint slot, GLuint sequence)
+{
+	return ((std::uint64_t)pass << PASS_SHIFT) | (((std::uint64_t)slot & SLOT_MASK) << SLOT_SHIFT) | sequence;
+}
+
+///////////////////////////////////////////////////
+//	PassOf(std::uint64_t)
+//
+//	Return the pass a sort key belongs to
+///////////////////////////////////////////////////
+int RenderCommandList::PassOf(std::uint64_t sortKey)
+{
+	return (int)(sortKey >> PASS_SHIFT);
+}
+
+///////////////////////////////////////////////////
+//	Add(RenderPacketType)
+//
+//	Append a packet keyed with the current slot
+///////////////////////////////////////////////////
+RenderPacket& RenderCommandList::Add(RenderPacketType type)
+{
+	packets.emplace_back();
+	RenderPacket& packet = packets.back();
+	packet.sortKey = SortKey(pass, slot, sequence++);
+	packet.type = type;
+	return packet;
+}
+
+///////////////////////////////////////////////////
+//	Merge(const std::vector<const RenderCommandList*>&)
+//
+//	lists: command lists recorded for the frame
+//
+//	Gather the packets of every list and sort them by key
+///////////////////////////////////////////////////
+void RenderCommandQueue::Merge(const std::vector<const RenderCommandList*>& lists)
+{
+	packets.clear();
+	for (const RenderCommandList* list : lists)
+		packets.insert(packets.end(), list->packets.begin(), list->packets.end());
+
+	std::stable_sort(packets.begin(), packets.end(),
+		[](const RenderPacket& a, const RenderPacket& b) { return a.sortKey < b.sortKey; });
+	nExecuted = 0;
+}
+
+///////////////////////////////////////////////////
+//	ExecutePass(int, RenderStateCache&)
+//
+//	pass: pass to execute
+//	state: cache the program and texture binds go through
+//
+//	Issue the GL calls of the packets of one pass; must run
+//	on the thread that owns the context
+///////////////////////////////////////////////////
+void RenderCommandQueue::ExecutePass(int pass, RenderStateCache& state)
+{
+	auto first = std::lower_bound(packets.begin(), packets.end(), RenderCommandList::SortKey(pass, 0, 0),
+		[](const RenderPacket& packet, std::uint64_t key) { return packet.sortKey < key; });
+
+	for (auto packet = first; packet != packets.end() && RenderCommandList::PassOf(packet->sortKey) == pass; ++packet)
+	{
+		switch (packet->type)
+		{
+		case RENDER_PACKET_USE_PROGRAM:
+			state.UseProgram(packet->useProgram.program);
+			break;
+		case RENDER_PACKET_BIND_TEXTURE:
+			state.BindTexture(packet->bindTexture.unit, packet->bindTexture.target, packet->bindTexture.texture);
+			break;
+		case RENDER_PACKET_BIND_RANGE:
+			glBindBufferRange(packet->bindRange.target, packet->bindRange.binding, packet->bindRange.buffer,
+				packet->bindRange.offset, packet->bindRange.size);
+			break;
+		case RENDER_PACKET_UNIFORM_UINT:
+			glUniform1ui(packet->uniform.location, packet->uniform.value);
+			break;
+		case RENDER_PACKET_DRAW:
+			glMultiDrawElementsIndirect(packet->draw.mode, GL_UNSIGNED_INT, (const void*)packet->draw.indirect, packet->draw.drawCount, 0);
+			break;
+		}
+		++nExecuted;
+	}
+}
@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////
+// rendercommands.h
+// ========
+// render command packets recorded off the GL thread and executed on it
+//
+// Worker threads record what a pass draws into their own command lists as
+// small packets instead of calling GL. Every packet carries a sort key whose
+// top bits are the pass, then the slot of the draw group in the pass, then
+// the order it was recorded in. The GL thread merges the lists of the frame
+// into one queue sorted by key and executes it pass by pass, between the
+// framebuffer and state changes of each pass.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "renderstate.h"
+
+enum RenderPacketType
+{
+	RENDER_PACKET_USE_PROGRAM,
+	RENDER_PACKET_BIND_TEXTURE,
+	RENDER_PACKET_BIND_RANGE,       // buffer range on an indexed binding point
+	RENDER_PACKET_UNIFORM_UINT,     // uniform of the current program
+	RENDER_PACKET_DRAW              // glMultiDrawElementsIndirect from the bound indirect buffer
+};
+
+struct RenderPacket
+{
+	std::uint64_t sortKey;
+	RenderPacketType type;
+	union
+	{
+		struct { GLuint program; } useProgram;
+		struct { GLint unit; GLenum target; GLuint texture; } bindTexture;
+		struct { GLenum target; GLuint binding; GLuint buffer; GLintptr offset; GLsizeiptr size; } bindRange;
+		struct { GLint location; GLuint value; } uniform;
+		struct { GLenum mode; GLintptr indirect; GLsizei drawCount; } draw;
+	};
+};
+
+// Packets recorded by one thread, already in key order within each slot
+class RenderCommandList
+{
+public:
+	std::vector<RenderPacket> packets;
+
+public:
+	void Clear();
+	void SetSlot(int pass, GLuint slot);
+	void UseProgram(GLuint program);
+	void BindTexture(int unit, GLenum target, GLuint texture);
+	void BindRange(GLenum target, GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	void SetUniform(GLint location, GLuint value);
+	void Draw(GLenum mode, const void* indirect, GLsizei drawCount);
+
+	static std::uint64_t SortKey(int pass, GLuint slot, GLuint sequence);
+	static int PassOf(std::uint64_t sortKey);
+
+private:
+	RenderPacket& Add(RenderPacketType type);
+
+	int pass = 0;
+	GLuint slot = 0;
+	GLuint sequence = 0;                // packets recorded in the slot so far
+};
+
+// Packets of every list of the frame, merged in sort key order
+class RenderCommandQueue
+{
+public:
+	std::vector<RenderPacket> packets;
+	int nExecuted = 0;                  // packets executed this frame
+
+public:
+	void Merge(const std::vector<const RenderCommandList*>& lists);
+	void ExecutePass(int pass, RenderStateCache& state);
+};
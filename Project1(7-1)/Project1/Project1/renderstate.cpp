@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderstate.cpp
+// ========
+// shadow copy of the GL binding state that skips redundant binds
+///////////////////////////////////////////////////////////////////////////////
+
+#include "renderstate.h"
+
+///////////////////////////////////////////////////
+//	UseProgram(GLuint)
+//
+//	Make the program current unless it already is
+///////////////////////////////////////////////////
+void RenderStateCache::UseProgram(GLuint program)
+{
+	if (Update(this->program, program))
+		glUseProgram(program);
+}
+
+///////////////////////////////////////////////////
+//	BindVertexArray(GLuint)
+//
+//	Bind the vertex array unless it already is; passes
+//	leave their vertex array bound for the next one
+///////////////////////////////////////////////////
+void RenderStateCache::BindVertexArray(GLuint vao)
+{
+	if (Update(this->vao, vao))
+		glBindVertexArray(vao);
+}
+
+///////////////////////////////////////////////////
+//	BindFramebuffer(GLuint)
+//
+//	Bind the framebuffer for drawing and reading unless it
+//	already is; 0 is the window
+///////////////////////////////////////////////////
+void RenderStateCache::BindFramebuffer(GLuint fbo)
+{
+	if (Update(framebuffer, fbo))
+		glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+///////////////////////////////////////////////////
+//	BindTexture(int, GLenum, GLuint)
+//
+//	unit: texture unit, below TEXTURE_UNITS
+//	target: GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY...
+//	texture: texture to bind, 0 for none
+//
+//	Bind the texture on the unit, switching the active unit
+//	only when the texture is not there already
+///////////////////////////////////////////////////
+void RenderStateCache::BindTexture(int unit, GLenum target, GLuint texture)
+{
+	if (textureTargets[unit] == target && textures[unit] == texture)
+	{
+		++nSaved;
+		return;
+	}
+
+	if (Update(activeUnit, (GLuint)unit))
+		glActiveTexture(GL_TEXTURE0 + unit);
+
+	glBindTexture(target, texture);
+	++nIssued;
+	textureTargets[unit] = target;
+	textures[unit] = texture;
+}
+
+///////////////////////////////////////////////////
+//	Invalidate()
+//
+//	Forget every binding, so the next bind of each kind
+//	reaches GL whatever was bound behind the cache's back
+///////////////////////////////////////////////////
+void RenderStateCache::Invalidate()
+{
+	program = UNKNOWN;
+	vao = UNKNOWN;
+	framebuffer = UNKNOWN;
+	activeUnit = UNKNOWN;
+	for (int unit = 0; unit < TEXTURE_UNITS; ++unit)
+	{
+		textures[unit] = 0;
+		textureTargets[unit] = 0;
+	}
+}
+
+///////////////////////////////////////////////////
+//	EndFrame()
+//
+//	Keep the counts of the frame and start new ones
+///////////////////////////////////////////////////
+void RenderStateCache::EndFrame()
+{
+	nLastIssued = nIssued;
+	nLastSaved = nSaved;
+	nIssued = 0;
+	nSaved = 0;
+}
+
+///////////////////////////////////////////////////
+//	Update(GLuint&, GLuint)
+//
+//	Record a binding and count it; return whether it
+//	differs from the current one and has to reach GL
+///////////////////////////////////////////////////
+bool RenderStateCache::Update(GLuint& current, GLuint value)
+{
+	if (current == value)
+	{
+		++nSaved;
+		return false;
+	}
+
+	current = value;
+	++nIssued;
+	return true;
+}
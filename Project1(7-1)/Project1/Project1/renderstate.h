@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// renderstate.h
+// ========
+// shadow copy of the GL binding state that skips redundant binds
+//
+// Programs, vertex arrays, framebuffers and the textures of each unit are
+// bound through the cache while rendering; a bind of what is already bound
+// is not passed to GL and is counted as saved instead. Code that binds any
+// of these directly, such as the Create() functions of the render targets,
+// must call Invalidate() afterwards.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+class RenderStateCache
+{
+public:
+	static const int TEXTURE_UNITS = 8;     // units the renderer samples from, see the *_UNIT constants
+
+	// Calls passed to GL and calls skipped during the current frame
+	int nIssued = 0;
+	int nSaved = 0;
+
+	// The same for the last finished frame
+	int nLastIssued = 0;
+	int nLastSaved = 0;
+
+public:
+	void UseProgram(GLuint program);
+	void BindVertexArray(GLuint vao);
+	void BindFramebuffer(GLuint fbo);
+	void BindTexture(int unit, GLenum target, GLuint texture);
+	void Invalidate();
+	void EndFrame();
+
+private:
+	bool Update(GLuint& current, GLuint value);
+
+	// UNKNOWN until first bound through the cache
+	static const GLuint UNKNOWN = 0xffffffffu;
+
+	GLuint program = UNKNOWN;
+	GLuint vao = UNKNOWN;
+	GLuint framebuffer = UNKNOWN;
+	GLuint activeUnit = UNKNOWN;
+	GLuint textures[TEXTURE_UNITS] = {};
+	GLenum textureTargets[TEXTURE_UNITS] = {};  // 0 when the texture of the unit is unknown
+};
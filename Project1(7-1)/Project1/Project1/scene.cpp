@@ -0,0 +1,836 @@
+///////////////////////////////////////////////////////////////////////////////
+// scene.cpp
+// ========
+// load the garden scene description into a flat array of instances
+///////////////////////////////////////////////////////////////////////////////
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include <glm/gtx/transform.hpp>
+
+
+namespace
+{
+	// Names used for the mesh column of the scene file, in SceneMesh order
+	const char* const MESH_NAMES[SCENE_MESH_COUNT] = {
+		"plane",
+		"box",
+		"cylinder",
+		"tapered_cylinder",
+		"sphere",
+		"torus",
+		"cone"
+	};
+}
+
+///////////////////////////////////////////////////
+//	SceneMeshName(SceneMesh)
+//
+//	Return the name the scene file uses for a mesh
+///////////////////////////////////////////////////
+const char* SceneMeshName(SceneMesh mesh)
+{
+	return MESH_NAMES[mesh];
+}
+
+///////////////////////////////////////////////////
+//	LoadScene(const char*, const Meshes&, const std::vector<SceneTexture>&)
+//
+//	filename: path of the scene description file
+//	meshes: created meshes the instances are drawn with
+//	textures: loaded textures the scene file can refer to by name
+//
+//	Parse the scene file, one group or instance per line:
+//
+//	group name parent  sx sy sz  angle ax ay az  tx ty tz
+//	light r g b  radius  shadow  tx ty tz  [parent]
+//	program mesh texture  sx sy sz  angle ax ay az  tx ty tz  u v  [parent]
+//
+//	A parent must be a group defined on an earlier line, or '-'
+//	for none; the transform of a child is relative to its parent
+///////////////////////////////////////////////////
+bool Scene::LoadScene(const char* filename, const Meshes& meshes, const std::vector<SceneTexture>& textures)
+{
+	std::ifstream file(filename);
+	if (!file)
+	{
+		std::cout << "ERROR::SCENE::FILE_NOT_FOUND " << filename << std::endl;
+		return false;
+	}
+
+	Clear();
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		++lineNumber;
+
+		// skip blank lines and comments
+		std::size_t start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		std::string programName;
+		fields >> programName;
+
+		SceneNode node;
+		node.parent = -1;
+		node.instance = -1;
+		node.dirty = true;
+		node.changed = false;
+
+		std::string groupName, parentName = "-";
+		if (programName == "group")
+			fields >> groupName >> parentName;
+
+		SceneInstance instance;
+		std::string meshName, textureName;
+		if (programName != "group" && programName != "light")
+			fields >> meshName >> textureName;
+
+		// lights only have a position, the rest of their transform is the identity
+		SceneLight light;
+		if (programName == "light")
+		{
+			fields >> light.color.r >> light.color.g >> light.color.b >> light.radius >> light.shadowNear
+				>> node.position.x >> node.position.y >> node.position.z;
+			node.scale = glm::vec3(1.0f);
+			node.rotationAngle = 0.0f;
+			node.rotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+		else
+		{
+			fields >> node.scale.x >> node.scale.y >> node.scale.z
+				>> node.rotationAngle
+				>> node.rotationAxis.x >> node.rotationAxis.y >> node.rotationAxis.z
+				>> node.position.x >> node.position.y >> node.position.z;
+		}
+
+		if (programName != "group")
+		{
+			if (programName != "light")
+				fields >> instance.uvScale.x >> instance.uvScale.y;
+
+			// the parent column is optional for objects and lights
+			if (!fields.fail() && !(fields >> parentName))
+			{
+				parentName = "-";
+				fields.clear();
+			}
+		}
+
+		if (fields.fail())
+		{
+			std::cout << "ERROR::SCENE::MALFORMED_LINE " << filename << ":" << lineNumber << std::endl;
+			return false;
+		}
+
+		if (parentName != "-")
+		{
+			node.parent = FindNode(parentName);
+			if (node.parent < 0)
+			{
+				std::cout << "ERROR::SCENE::UNKNOWN_PARENT " << parentName << " at " << filename << ":" << lineNumber << std::endl;
+				return false;
+			}
+		}
+
+		if (programName == "group")
+		{
+			if (FindNode(groupName) >= 0)
+			{
+				std::cout << "ERROR::SCENE::DUPLICATE_GROUP " << groupName << " at " << filename << ":" << lineNumber << std::endl;
+				return false;
+			}
+			node.name = groupName;
+			nodes.push_back(node);
+			continue;
+		}
+
+		if (programName == "light")
+		{
+			light.node = (int)nodes.size();
+			light.sourceLine = lineNumber;
+			nodes.push_back(node);
+			lights.push_back(light);
+			continue;
+		}
+
+		if (programName == "lit")
+			instance.program = SCENE_PROGRAM_LIT;
+		else if (programName == "lamp")
+			instance.program = SCENE_PROGRAM_LAMP;
+		else
+		{
+			std::cout << "ERROR::SCENE::UNKNOWN_PROGRAM " << programName << " at " << filename << ":" << lineNumber << std::endl;
+			return false;
+		}
+
+		if (!ParseMesh(meshName, instance.mesh))
+		{
+			std::cout << "ERROR::SCENE::UNKNOWN_MESH " << meshName << " at " << filename << ":" << lineNumber << std::endl;
+			return false;
+		}
+
+		instance.textureId = 0;
+		instance.textureLayer = 0;
+		if (textureName != "none")
+		{
+			bool found = false;
+			for (const SceneTexture& texture : textures)
+			{
+				if (texture.name == textureName)
+				{
+					instance.textureId = texture.textureId;
+					instance.textureLayer = texture.layer;
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				std::cout << "ERROR::SCENE::UNKNOWN_TEXTURE " << textureName << " at " << filename << ":" << lineNumber << std::endl;
+				return false;
+			}
+		}
+
+		instance.dirty = true;
+		instance.sourceLine = lineNumber;
+		SetDrawRange(meshes, instance);
+
+		node.instance = (int)instances.size();
+		instance.node = (int)nodes.size();
+		nodes.push_back(node);
+		instances.push_back(instance);
+	}
+
+	SortNodesBreadthFirst();
+	BuildBatches();
+	BuildDrawCommands();
+
+	std::cout << "INFO: Loaded " << instances.size() << " scene instances and " << lights.size() << " lights as " << drawCommands.size() << " indirect draws in "
+		<< drawGroups.size() << " multi-draw calls from " << filename << std::endl;
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	CreateDrawBuffers()
+//
+//	Create the instance shader storage buffer; it keeps the
+//	instances between frames, while what culling writes
+//	goes to the frame ring
+///////////////////////////////////////////////////
+void Scene::CreateDrawBuffers()
+{
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(SceneInstanceData) * instanceData.size(), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////
+//	ReserveCullRanges(FrameRing&, int)
+//
+//	ring: frame ring not created yet
+//	cullsPerFrame: most CullInstances() calls in one frame
+//
+//	Account for the visible list, per-draw data and indirect
+//	commands every culling writes
+///////////////////////////////////////////////////
+void Scene::ReserveCullRanges(FrameRing& ring, int cullsPerFrame) const
+{
+	ring.Reserve(sizeof(GLuint) * instances.size(), cullsPerFrame);
+	ring.Reserve(sizeof(SceneDrawData) * drawData.size(), cullsPerFrame);
+	ring.Reserve(sizeof(SceneDrawCommand) * drawCommands.size(), cullsPerFrame);
+}
+
+///////////////////////////////////////////////////
+//	FindNode(const std::string&)
+//
+//	Return the index of the group with the given name, or -1
+///////////////////////////////////////////////////
+int Scene::FindNode(const std::string& name) const
+{
+	for (std::size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (!nodes[i].name.empty() && nodes[i].name == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+///////////////////////////////////////////////////
+//	MarkNodeDirty(int)
+//
+//	Flag a node whose local position, rotation or scale
+//	changed; it and its whole subtree are recomposed by
+//	the next UpdateInstanceBuffer()
+///////////////////////////////////////////////////
+void Scene::MarkNodeDirty(int nodeIndex)
+{
+	nodes[nodeIndex].dirty = true;
+}
+
+///////////////////////////////////////////////////
+//	UpdateInstanceBuffer()
+//
+//	Update the hierarchy, then compose the normal matrices
+//	and bounding spheres of the instances whose world
+//	matrix changed and upload the span that covers them;
+//	nothing is uploaded when the scene did not change.
+//	The region the moved instances left and entered is
+//	kept so cached shadows know whether to redraw
+///////////////////////////////////////////////////
+void Scene::UpdateInstanceBuffer()
+{
+	UpdateWorldTransforms();
+
+	std::size_t firstDirty = instances.size();
+	std::size_t lastDirty = 0;
+
+	// before the first build the old bounds are not set yet
+	bool hasOldBounds = !bvh.nodes.empty();
+	instancesMoved = false;
+	movedBoundsMin = glm::vec3(std::numeric_limits<float>::max());
+	movedBoundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (std::size_t i = 0; i < instances.size(); ++i)
+	{
+		SceneInstance& instance = instances[i];
+		if (!instance.dirty)
+			continue;
+
+		const glm::mat4& model = nodes[instance.node].world;
+
+		// normals are transformed without translation and with the inverse scale
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+		SceneInstanceData& data = instanceData[i];
+		data.model = model;
+		for (int column = 0; column < 3; ++column)
+			data.normalMatrix[column] = glm::vec4(normalMatrix[column], 0.0f);
+		data.uvScale = instance.uvScale;
+		data.textureLayer = instance.textureLayer;
+		data.padding = 0;
+
+		// world bounding sphere, grown by the largest axis scale so it stays conservative
+		glm::vec3 center = glm::vec3(model * glm::vec4(instance.boundsCenter, 1.0f));
+		float maxScale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		boundsX[i] = center.x;
+		boundsY[i] = center.y;
+		boundsZ[i] = center.z;
+		boundsRadius[i] = instance.boundsRadius * maxScale;
+
+		// box around the transformed mesh box: each world axis gathers the absolute projections of the local half extents
+		glm::vec3 halfExtent(0.0f);
+		for (int column = 0; column < 3; ++column)
+			halfExtent += glm::abs(glm::vec3(model[column])) * instance.boundsHalfExtent[column];
+		if (hasOldBounds)
+		{
+			movedBoundsMin = glm::min(movedBoundsMin, instance.worldBoundsMin);
+			movedBoundsMax = glm::max(movedBoundsMax, instance.worldBoundsMax);
+		}
+		instance.worldBoundsMin = center - halfExtent;
+		instance.worldBoundsMax = center + halfExtent;
+		movedBoundsMin = glm::min(movedBoundsMin, instance.worldBoundsMin);
+		movedBoundsMax = glm::max(movedBoundsMax, instance.worldBoundsMax);
+		instancesMoved = true;
+
+		instance.dirty = false;
+		firstDirty = std::min(firstDirty, i);
+		lastDirty = i;
+	}
+
+	if (firstDirty > lastDirty)
+		return;
+
+	// the first update builds the hierarchy, later ones refit it
+	if (bvh.nodes.empty())
+		bvh.Build(boundsX.data(), boundsY.data(), boundsZ.data(), boundsRadius.data(), instances.size());
+	else
+		bvh.Refit(boundsX.data(), boundsY.data(), boundsZ.data(), boundsRadius.data());
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(SceneInstanceData) * firstDirty,
+		sizeof(SceneInstanceData) * (lastDirty - firstDirty + 1), &instanceData[firstDirty]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+///////////////////////////////////////////////////
+//	CullInstances(FrameRing&, const glm::mat4&, SceneView&, bool, int)
+//
+//	ring: receives the visible list, per-draw data and commands
+//	viewProjection: projection * view matrix of the camera
+//	view: receives the culling, its lists are reused
+//	frontToBack: whether to order the draws nearest first
+//	bvhRoot: BVH node below which instances are culled; the
+//	others are left out of the view as if culled
+//
+//	Walk the BVH against the view frustum, sort the visible
+//	instances so they are grouped batch by batch and point
+//	the indirect commands at them; culled batches keep their
+//	command with an instance count of 0. Front to back, the
+//	instances of each batch, the commands inside each group
+//	and then drawGroupOrder are sorted by depth so early
+//	depth testing rejects hidden fragments; commands and
+//	draw data move together, so drawIdOffset + gl_DrawID
+//	still finds the data of its command.
+//	Only the view and the ring are written, so different
+//	views may be culled on different threads
+///////////////////////////////////////////////////
+void Scene::CullInstances(FrameRing& ring, const glm::mat4& viewProjection, SceneView& view, bool frontToBack, int bvhRoot) const
+{
+	view.visibleInstances.resize(instances.size());
+	view.batchFirstVisible.resize(batches.size());
+	view.batchVisibleCount.resize(batches.size());
+	view.drawCommands.resize(drawCommands.size());
+	view.drawData.resize(drawData.size());
+
+	Frustum frustum = ExtractFrustum(viewProjection);
+	view.nVisibleInstances = bvh.CullFrustum(frustum, view.visibleInstances.data(), bvhRoot);
+	std::sort(view.visibleInstances.begin(), view.visibleInstances.begin() + view.nVisibleInstances);
+
+	// the visible list is sorted and batches are contiguous, so one walk splits it per batch
+	std::size_t visible = 0;
+	for (std::size_t b = 0; b < batches.size(); ++b)
+	{
+		GLuint end = batches[b].firstInstance + batches[b].instanceCount;
+		view.batchFirstVisible[b] = (GLuint)visible;
+		while (visible < view.nVisibleInstances && view.visibleInstances[visible] < end)
+			++visible;
+		view.batchVisibleCount[b] = (GLsizei)(visible - view.batchFirstVisible[b]);
+	}
+
+	view.commandOrder.resize(drawCommands.size());
+	for (std::size_t i = 0; i < drawCommands.size(); ++i)
+		view.commandOrder[i] = (GLuint)i;
+
+	view.drawGroupOrder.resize(drawGroups.size());
+	for (std::size_t i = 0; i < drawGroups.size(); ++i)
+		view.drawGroupOrder[i] = (GLuint)i;
+
+	if (frontToBack)
+	{
+		// clip space z grows with view depth in both the perspective and the ortho projection
+		glm::vec4 depthRow(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		auto depth = [&](GLuint instance)
+		{
+			return glm::dot(depthRow, glm::vec4(boundsX[instance], boundsY[instance], boundsZ[instance], 1.0f));
+		};
+
+		for (std::size_t batch = 0; batch < batches.size(); ++batch)
+		{
+			auto first = view.visibleInstances.begin() + view.batchFirstVisible[batch];
+			std::sort(first, first + view.batchVisibleCount[batch], [&](GLuint a, GLuint b) { return depth(a) < depth(b); });
+		}
+
+		// a command is as near as the first instance of its sorted batch; culled ones go last
+		view.commandDepths.resize(drawCommands.size());
+		for (std::size_t command = 0; command < drawCommands.size(); ++command)
+		{
+			int batch = drawCommandBatches[command];
+			view.commandDepths[command] = view.batchVisibleCount[batch] > 0
+				? depth(view.visibleInstances[view.batchFirstVisible[batch]])
+				: std::numeric_limits<float>::max();
+		}
+
+		// commands only move inside their group, which keeps every group one contiguous run,
+		// and a group is then as near as its first command
+		view.groupDepths.resize(drawGroups.size());
+		for (std::size_t g = 0; g < drawGroups.size(); ++g)
+		{
+			const SceneDrawGroup& group = drawGroups[g];
+			auto first = view.commandOrder.begin() + group.firstCommand;
+			std::stable_sort(first, first + group.commandCount,
+				[&](GLuint a, GLuint b) { return view.commandDepths[a] < view.commandDepths[b]; });
+			view.groupDepths[g] = view.commandDepths[*first];
+		}
+
+		std::stable_sort(view.drawGroupOrder.begin(), view.drawGroupOrder.end(),
+			[&](GLuint a, GLuint b) { return view.groupDepths[a] < view.groupDepths[b]; });
+	}
+
+	for (std::size_t i = 0; i < drawCommands.size(); ++i)
+	{
+		GLuint source = view.commandOrder[i];
+		int batch = drawCommandBatches[source];
+		view.drawCommands[i] = drawCommands[source];
+		view.drawCommands[i].instanceCount = (GLuint)view.batchVisibleCount[batch];
+		view.drawCommands[i].baseInstance = view.batchFirstVisible[batch];
+		view.drawData[i] = drawData[source];
+		view.drawData[i].firstInstance = view.batchFirstVisible[batch];
+	}
+
+	// every view of the frame gets fresh ranges, so passes drawn earlier keep reading theirs
+	view.visibleRange = ring.Write(view.visibleInstances.data(), sizeof(GLuint) * view.nVisibleInstances);
+	view.drawDataRange = ring.Write(view.drawData.data(), sizeof(SceneDrawData) * view.drawData.size());
+	view.commandRange = ring.Write(view.drawCommands.data(), sizeof(SceneDrawCommand) * view.drawCommands.size());
+}
+
+///////////////////////////////////////////////////
+//	PickInstance(const glm::vec3&, const glm::vec3&, float&)
+//
+//	origin, direction: world space ray, for example through the cursor
+//	distance: receives the distance along the ray, in direction units
+//
+//	Return the closest instance whose world box the ray hits, or -1
+///////////////////////////////////////////////////
+int Scene::PickInstance(const glm::vec3& origin, const glm::vec3& direction, float& distance) const
+{
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	return bvh.Raycast(origin, direction,
+		[&](GLuint instanceIndex)
+		{
+			const SceneInstance& instance = instances[instanceIndex];
+			return IntersectRayBox(origin, inverseDirection, instance.worldBoundsMin, instance.worldBoundsMax);
+		},
+		distance);
+}
+
+///////////////////////////////////////////////////
+//	GatherLights(std::vector<PointLight>&)
+//
+//	pointLights: receives one world space light per scene light
+//
+//	Read the light positions from the world matrices, so
+//	call it after UpdateInstanceBuffer()
+///////////////////////////////////////////////////
+void Scene::GatherLights(std::vector<PointLight>& pointLights) const
+{
+	pointLights.resize(lights.size());
+	for (std::size_t i = 0; i < lights.size(); ++i)
+	{
+		PointLight& pointLight = pointLights[i];
+		pointLight.position = glm::vec3(nodes[lights[i].node].world[3]);
+		pointLight.radius = lights[i].radius;
+		pointLight.color = lights[i].color;
+		pointLight.shadowSlot = -1;
+	}
+}
+
+///////////////////////////////////////////////////
+//	BindDrawBuffers(const FrameRing&)
+//
+//	Bind the instance buffer to its shader binding point and
+//	the ring as the indirect buffer for drawing; the ranges
+//	of each view are bound by the commands drawing it
+///////////////////////////////////////////////////
+void Scene::BindDrawBuffers(const FrameRing& ring) const
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, instanceBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.buffer);
+}
+
+///////////////////////////////////////////////////
+//	IndirectOffset(const SceneView&, const SceneDrawGroup&)
+//
+//	Return the indirect pointer of the first command of the
+//	group, in the ring range of the view
+///////////////////////////////////////////////////
+const void* Scene::IndirectOffset(const SceneView& view, const SceneDrawGroup& group) const
+{
+	return (const void*)(view.commandRange.offset + sizeof(SceneDrawCommand) * group.firstCommand);
+}
+
+///////////////////////////////////////////////////
+//	DestroyDrawBuffers()
+//
+//	Release the instance buffer
+///////////////////////////////////////////////////
+void Scene::DestroyDrawBuffers()
+{
+	glDeleteBuffers(1, &instanceBuffer);
+	instanceBuffer = 0;
+}
+
+///////////////////////////////////////////////////
+//	Clear()
+//
+//	Remove every instance from the scene
+///////////////////////////////////////////////////
+void Scene::Clear()
+{
+	nodes.clear();
+	instances.clear();
+	lights.clear();
+	bvh = Bvh();
+	batches.clear();
+	instanceData.clear();
+	drawCommands.clear();
+	drawData.clear();
+	drawCommandBatches.clear();
+	drawGroups.clear();
+	boundsX.clear();
+	boundsY.clear();
+	boundsZ.clear();
+	boundsRadius.clear();
+}
+
+///////////////////////////////////////////////////
+//	ParseMesh(const std::string&, SceneMesh&)
+//
+//	Map a mesh name from the scene file to its SceneMesh value
+///////////////////////////////////////////////////
+bool Scene::ParseMesh(const std::string& name, SceneMesh& mesh) const
+{
+	for (int i = 0; i < SCENE_MESH_COUNT; ++i)
+	{
+		if (name == MESH_NAMES[i])
+		{
+			mesh = static_cast<SceneMesh>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////
+//	SortNodesBreadthFirst()
+//
+//	Reorder the nodes so roots come first, followed by each
+//	level of the hierarchy, and remap the node indices
+///////////////////////////////////////////////////
+void Scene::SortNodesBreadthFirst()
+{
+	std::vector<std::vector<int>> children(nodes.size());
+	std::vector<int> order;
+	for (std::size_t i = 0; i < nodes.size(); ++i)
+	{
+		if (nodes[i].parent < 0)
+			order.push_back((int)i);
+		else
+			children[nodes[i].parent].push_back((int)i);
+	}
+
+	// order grows while it is walked, one level after the other
+	for (std::size_t i = 0; i < order.size(); ++i)
+		order.insert(order.end(), children[order[i]].begin(), children[order[i]].end());
+
+	std::vector<int> newIndex(nodes.size());
+	for (std::size_t i = 0; i < order.size(); ++i)
+		newIndex[order[i]] = (int)i;
+
+	std::vector<SceneNode> sorted;
+	sorted.reserve(nodes.size());
+	for (int oldIndex : order)
+	{
+		SceneNode node = nodes[oldIndex];
+		if (node.parent >= 0)
+			node.parent = newIndex[node.parent];
+		sorted.push_back(node);
+	}
+	nodes.swap(sorted);
+
+	for (SceneInstance& instance : instances)
+		instance.node = newIndex[instance.node];
+	for (SceneLight& light : lights)
+		light.node = newIndex[light.node];
+}
+
+///////////////////////////////////////////////////
+//	UpdateWorldTransforms()
+//
+//	Recompose the world matrix of every dirty node and of
+//	every node below one; untouched subtrees are skipped
+///////////////////////////////////////////////////
+void Scene::UpdateWorldTransforms()
+{
+	for (SceneNode& node : nodes)
+	{
+		bool parentChanged = node.parent >= 0 && nodes[node.parent].changed;
+		node.changed = node.dirty || parentChanged;
+		if (!node.changed)
+			continue;
+
+		// Model matrix: transformations are applied right-to-left order
+		glm::mat4 local = glm::translate(node.position)
+			* glm::rotate(node.rotationAngle, node.rotationAxis)
+			* glm::scale(node.scale);
+
+		node.world = node.parent >= 0 ? nodes[node.parent].world * local : local;
+		node.dirty = false;
+
+		if (node.instance >= 0)
+			instances[node.instance].dirty = true;
+	}
+}
+
+///////////////////////////////////////////////////
+//	SetDrawRange(const Meshes&, SceneInstance&)
+//
+//	Fill in the draw call for the instance's mesh inside the
+//	shared buffers, matching the drawing commands in meshes.cpp
+///////////////////////////////////////////////////
+void Scene::SetDrawRange(const Meshes& meshes, SceneInstance& instance) const
+{
+	const Meshes::GLMesh* mesh = nullptr;
+
+	switch (instance.mesh)
+	{
+	case SCENE_MESH_PLANE:
+		mesh = &meshes.gPlaneMesh;
+		break;
+
+	case SCENE_MESH_BOX:
+		mesh = &meshes.gBoxMesh;
+		break;
+
+	case SCENE_MESH_CYLINDER:
+	case SCENE_MESH_TAPERED_CYLINDER:
+		mesh = instance.mesh == SCENE_MESH_CYLINDER ? &meshes.gCylinderMesh : &meshes.gTaperedCylinderMesh;
+		break;
+
+	case SCENE_MESH_SPHERE:
+		mesh = &meshes.gSphereMesh;
+		break;
+
+	case SCENE_MESH_TORUS:
+		mesh = &meshes.gTorusMesh;
+		break;
+
+	case SCENE_MESH_CONE:
+		mesh = &meshes.gConeMesh;
+		break;
+
+	default:
+		return;
+	}
+
+	// every primitive, caps and sides of the cylinders included, is one indexed triangle list
+	instance.drawRange = { GL_TRIANGLES, mesh->firstIndex, (GLsizei)mesh->nIndices, mesh->baseVertex, mesh->positionOffset, mesh->positionScale };
+
+	instance.boundsCenter = mesh->boundsCenter;
+	instance.boundsHalfExtent = mesh->boundsHalfExtent;
+	instance.boundsRadius = mesh->boundsRadius;
+}
+
+///////////////////////////////////////////////////
+//	BuildBatches()
+//
+//	Sort the instances by program, mesh and texture, then
+//	group every run of identical keys into one batch
+///////////////////////////////////////////////////
+void Scene::BuildBatches()
+{
+	// stable so that instances of a batch keep their scene file order
+	std::stable_sort(instances.begin(), instances.end(),
+		[](const SceneInstance& a, const SceneInstance& b)
+		{
+			if (a.program != b.program)
+				return a.program < b.program;
+			if (a.mesh != b.mesh)
+				return a.mesh < b.mesh;
+			return a.textureId < b.textureId;
+		});
+
+	// the nodes have to follow their instance to its sorted position
+	for (std::size_t i = 0; i < instances.size(); ++i)
+		nodes[instances[i].node].instance = (int)i;
+
+	batches.clear();
+	for (std::size_t i = 0; i < instances.size(); ++i)
+	{
+		const SceneInstance& instance = instances[i];
+		if (!batches.empty())
+		{
+			SceneBatch& last = batches.back();
+			const SceneInstance& previous = instances[i - 1];
+			if (previous.program == instance.program && previous.mesh == instance.mesh && previous.textureId == instance.textureId)
+			{
+				++last.instanceCount;
+				continue;
+			}
+		}
+
+		SceneBatch batch;
+		batch.program = instance.program;
+		batch.textureId = instance.textureId;
+		batch.drawRange = instance.drawRange;
+		batch.firstInstance = (GLuint)i;
+		batch.instanceCount = 1;
+		batches.push_back(batch);
+	}
+
+	instanceData.resize(instances.size());
+	boundsX.resize(instances.size());
+	boundsY.resize(instances.size());
+	boundsZ.resize(instances.size());
+	boundsRadius.resize(instances.size());
+}
+
+///////////////////////////////////////////////////
+//	BuildDrawCommands()
+//
+//	Turn every batch into an indirect command, then sort
+//	the commands by program, texture and primitive type so
+//	each run can be one multi-draw call
+///////////////////////////////////////////////////
+void Scene::BuildDrawCommands()
+{
+	struct PendingCommand
+	{
+		SceneProgram program;
+		GLuint textureId;
+		GLenum mode;
+		int batch;
+		SceneDrawCommand command;
+	};
+
+	std::vector<PendingCommand> pending;
+	for (std::size_t b = 0; b < batches.size(); ++b)
+	{
+		const SceneBatch& batch = batches[b];
+		const SceneDrawRange& range = batch.drawRange;
+		PendingCommand entry;
+		entry.program = batch.program;
+		entry.textureId = batch.textureId;
+		entry.mode = range.mode;
+		entry.batch = (int)b;
+		entry.command = { (GLuint)range.count, (GLuint)batch.instanceCount, range.firstIndex, range.baseVertex, batch.firstInstance };
+		pending.push_back(entry);
+	}
+
+	// state sort: program, then texture; every mesh lives in the one vertex array of
+	// Meshes, so this is also program, vertex array, texture order
+	std::stable_sort(pending.begin(), pending.end(),
+		[](const PendingCommand& a, const PendingCommand& b)
+		{
+			if (a.program != b.program)
+				return a.program < b.program;
+			if (a.textureId != b.textureId)
+				return a.textureId < b.textureId;
+			return a.mode < b.mode;
+		});
+
+	drawCommands.clear();
+	drawData.clear();
+	drawCommandBatches.clear();
+	drawGroups.clear();
+	for (const PendingCommand& entry : pending)
+	{
+		bool sameGroup = !drawGroups.empty()
+			&& drawGroups.back().program == entry.program
+			&& drawGroups.back().textureId == entry.textureId
+			&& drawGroups.back().mode == entry.mode;
+
+		if (sameGroup)
+			++drawGroups.back().commandCount;
+		else
+			drawGroups.push_back({ entry.program, entry.textureId, entry.mode, (GLuint)drawCommands.size(), 1 });
+
+		drawCommands.push_back(entry.command);
+		const SceneDrawRange& range = batches[entry.batch].drawRange;
+		drawData.push_back({ range.positionOffset, entry.command.baseInstance, range.positionScale, 0 });
+		drawCommandBatches.push_back(entry.batch);
+	}
+}
@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////
+// scene.h
+// ========
+// data-driven description of the objects drawn in the garden scene
+//
+// The scene is a flat array of instances loaded from a text file at startup,
+// so URender() only has to walk the array instead of hand-coding every object.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "framering.h"
+#include "lightclusters.h"
+#include "meshes(1).h"
+
+// Primitives from Meshes that a scene instance can reference
+enum SceneMesh
+{
+	SCENE_MESH_PLANE,
+	SCENE_MESH_BOX,
+	SCENE_MESH_CYLINDER,
+	SCENE_MESH_TAPERED_CYLINDER,
+	SCENE_MESH_SPHERE,
+	SCENE_MESH_TORUS,
+	SCENE_MESH_CONE,
+	SCENE_MESH_COUNT
+};
+
+// Shader program an instance is drawn with
+enum SceneProgram
+{
+	SCENE_PROGRAM_LIT,      // textured Phong shader
+	SCENE_PROGRAM_LAMP      // flat white light source marker
+};
+
+// One glDrawElementsBaseVertex call into the shared mesh buffers; every mesh is drawn with one
+struct SceneDrawRange
+{
+	GLenum mode;            // primitive type, GL_TRIANGLES for every mesh of Meshes
+	GLuint firstIndex;      // first index in the shared index buffer
+	GLsizei count;          // number of indices
+	GLint baseVertex;       // offset added to every index
+	glm::vec3 positionOffset;   // dequantization of the mesh's positions, see Meshes::GLMesh
+	glm::vec3 positionScale;
+};
+
+const char* SceneMeshName(SceneMesh mesh);
+
+// Named texture the scene file can refer to
+struct SceneTexture
+{
+	std::string name;
+	GLuint textureId;       // GL_TEXTURE_2D_ARRAY shared by the scene materials
+	GLuint layer;           // Layer of the material in textureId
+};
+
+// Node of the transform hierarchy. Nodes are stored breadth-first, so a
+// parent always comes before its children and one forward pass updates
+// every world matrix
+struct SceneNode
+{
+	std::string name;       // group name from the scene file, empty for object nodes
+	int parent;             // index into Scene::nodes, -1 for roots
+	int instance;           // index into Scene::instances, -1 for groups
+
+	glm::vec3 scale;        // Local transform, applied as translation * rotation * scale
+	float rotationAngle;
+	glm::vec3 rotationAxis;
+	glm::vec3 position;
+
+	glm::mat4 world;        // parent world * local
+	bool dirty;             // local transform changed since the last update
+	bool changed;           // world matrix was recomposed by the last update
+};
+
+// Everything needed to draw one object of the scene
+struct SceneInstance
+{
+	SceneMesh mesh;         // Primitive the object is built from
+	GLuint textureId;       // Texture array of the materials (0 for lamps)
+	GLuint textureLayer;    // Layer of the texture array the object samples
+	SceneProgram program;   // Shader program used to draw the object
+
+	int node;               // Transform of the object in Scene::nodes
+	glm::vec2 uvScale;      // Texture coordinate scale
+	glm::vec3 boundsCenter; // Bounding box and sphere of the mesh in model space
+	glm::vec3 boundsHalfExtent;
+	float boundsRadius;
+	glm::vec3 worldBoundsMin;   // World space box around the mesh box, used for picking
+	glm::vec3 worldBoundsMax;
+	int sourceLine;         // Line of the scene file the object was loaded from
+	bool dirty;             // world transform changed since it was last uploaded
+
+	SceneDrawRange drawRange;   // Where the mesh lives in the shared buffers
+};
+
+// Point light attached to a node of the hierarchy, so it moves with its prop
+struct SceneLight
+{
+	int node;               // Transform of the light in Scene::nodes, only its position is used
+	glm::vec3 color;
+	float radius;           // Distance at which the light fades out completely
+	float shadowNear;       // Near plane of its shadow cube, 0 when it casts no shadow
+	int sourceLine;         // Line of the scene file the light was loaded from
+};
+
+// Per-instance data read by the vertex shaders from an SSBO, std430 layout
+struct SceneInstanceData
+{
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];  // columns of the mat3 inverse transpose, each padded to a vec4 like std430 does
+	glm::vec2 uvScale;          // texture coordinate scale
+	GLuint textureLayer;        // layer of the material texture array
+	GLuint padding;             // std430 rounds the struct up to a multiple of 16 bytes
+};
+
+// Per-draw data, indexed in the shaders by drawIdOffset + gl_DrawID, std430 layout
+struct SceneDrawData
+{
+	glm::vec3 positionOffset;   // model space position = positionOffset + positionScale * vertex position
+	GLuint firstInstance;       // first entry of the draw in the visible instance list
+	glm::vec3 positionScale;
+	GLuint padding;             // std430 rounds the struct up to a multiple of 16 bytes
+};
+
+// Layout of one glMultiDrawElementsIndirect command
+struct SceneDrawCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Shader storage binding points of the scene buffers
+const GLuint INSTANCE_BUFFER_BINDING = 0;
+const GLuint DRAW_BUFFER_BINDING = 1;
+const GLuint VISIBLE_BUFFER_BINDING = 2;
+
+// Run of consecutive instances sharing program, mesh and texture,
+// drawn with one indirect command
+struct SceneBatch
+{
+	SceneProgram program;
+	GLuint textureId;
+	SceneDrawRange drawRange;
+	GLuint firstInstance;   // index of the first instance in the instance buffer
+	GLsizei instanceCount;
+};
+
+// Consecutive indirect commands submitted with one glMultiDrawElementsIndirect call;
+// commands are split only where the program, texture or primitive type changes
+struct SceneDrawGroup
+{
+	SceneProgram program;
+	GLuint textureId;
+	GLenum mode;
+	GLuint firstCommand;    // also the drawIdOffset of the group
+	GLsizei commandCount;
+};
+
+// What one culling of the scene produced: the visible instances and the commands
+// drawing them. Culling only reads the scene, so several views can be culled at once
+struct SceneView
+{
+	std::vector<GLuint> visibleInstances;       // indices of the instances in the frustum, per batch
+	std::size_t nVisibleInstances = 0;
+	std::vector<GLuint> batchFirstVisible;      // first entry of each batch in visibleInstances
+	std::vector<GLsizei> batchVisibleCount;     // instances of each batch that passed culling
+	std::vector<SceneDrawCommand> drawCommands; // commands of the scene with the counts of this view
+	std::vector<SceneDrawData> drawData;
+	std::vector<GLuint> commandOrder;           // Scene::drawCommands entry written to each slot of drawCommands
+	std::vector<float> commandDepths;           // clip depth of the nearest visible instance of each command, front to back only
+	std::vector<float> groupDepths;             // clip depth of the nearest visible instance of each group, front to back only
+	std::vector<GLuint> drawGroupOrder;         // indices of Scene::drawGroups in submission order
+
+	// The same lists written to the frame ring
+	FrameRingRange visibleRange = {};
+	FrameRingRange drawDataRange = {};
+	FrameRingRange commandRange = {};
+};
+
+class Scene
+{
+public:
+	std::vector<SceneNode> nodes;                   // breadth-first transform hierarchy
+	std::vector<SceneInstance> instances;           // sorted so that every batch is contiguous
+	std::vector<SceneLight> lights;
+	std::vector<SceneBatch> batches;
+	std::vector<SceneInstanceData> instanceData;    // one entry per instance, same order
+	std::vector<SceneDrawCommand> drawCommands;     // sorted so that every draw group is contiguous, every instance visible
+	std::vector<SceneDrawData> drawData;            // one entry per draw command, same order
+	std::vector<int> drawCommandBatches;            // batch each draw command comes from
+	std::vector<SceneDrawGroup> drawGroups;
+
+	// World space bounding spheres of the instances as separate arrays, input of the BVH
+	std::vector<float> boundsX;
+	std::vector<float> boundsY;
+	std::vector<float> boundsZ;
+	std::vector<float> boundsRadius;
+
+	Bvh bvh;                                        // over the bounding spheres, for culling and picking
+
+	// Box around the old and new world bounds of the instances the last update moved
+	bool instancesMoved = false;
+	glm::vec3 movedBoundsMin;
+	glm::vec3 movedBoundsMax;
+
+	GLuint instanceBuffer = 0;
+
+public:
+	bool LoadScene(const char* filename, const Meshes& meshes, const std::vector<SceneTexture>& textures);
+	void CreateDrawBuffers();
+	void ReserveCullRanges(FrameRing& ring, int cullsPerFrame) const;
+	int FindNode(const std::string& name) const;
+	void MarkNodeDirty(int nodeIndex);
+	void UpdateInstanceBuffer();
+	void CullInstances(FrameRing& ring, const glm::mat4& viewProjection, SceneView& view, bool frontToBack = false, int bvhRoot = 0) const;
+	int PickInstance(const glm::vec3& origin, const glm::vec3& direction, float& distance) const;
+	void GatherLights(std::vector<PointLight>& pointLights) const;
+	void BindDrawBuffers(const FrameRing& ring) const;
+	const void* IndirectOffset(const SceneView& view, const SceneDrawGroup& group) const;
+	void DestroyDrawBuffers();
+	void Clear();
+
+private:
+	bool ParseMesh(const std::string& name, SceneMesh& mesh) const;
+	void SortNodesBreadthFirst();
+	void UpdateWorldTransforms();
+	void SetDrawRange(const Meshes& meshes, SceneInstance& instance) const;
+	void BuildBatches();
+	void BuildDrawCommands();
+};
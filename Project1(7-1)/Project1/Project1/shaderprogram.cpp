@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderprogram.cpp
+// ========
+// reflect the active uniforms of a linked shader program
+///////////////////////////////////////////////////////////////////////////////
+
+#include "shaderprogram.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	///////////////////////////////////////////////////
+	//	GetResourceName(GLuint, GLenum, GLuint, GLint)
+	//
+	//	Read the name of a program resource; nameLength
+	//	includes the null terminator
+	///////////////////////////////////////////////////
+	std::string GetResourceName(GLuint programId, GLenum programInterface, GLuint index, GLint nameLength)
+	{
+		std::string name(nameLength, '\0');
+		glGetProgramResourceName(programId, programInterface, index, nameLength, nullptr, &name[0]);
+		name.resize(std::strlen(name.c_str()));
+		return name;
+	}
+}
+
+///////////////////////////////////////////////////
+//	Reflect()
+//
+//	Enumerate the active uniforms and uniform blocks
+//	of the linked program
+///////////////////////////////////////////////////
+void ShaderProgram::Reflect()
+{
+	uniforms.clear();
+	uniformBlocks.clear();
+
+	GLint nUniforms = 0;
+	glGetProgramInterfaceiv(id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &nUniforms);
+
+	const GLenum uniformProperties[] = { GL_NAME_LENGTH, GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION, GL_BLOCK_INDEX };
+	for (GLint i = 0; i < nUniforms; ++i)
+	{
+		GLint values[5];
+		glGetProgramResourceiv(id, GL_UNIFORM, i, 5, uniformProperties, 5, nullptr, values);
+
+		// members of uniform blocks are set through their buffer, not by location
+		if (values[4] != -1)
+			continue;
+
+		ShaderUniform uniform;
+		uniform.name = GetResourceName(id, GL_UNIFORM, i, values[0]);
+		uniform.type = values[1];
+		uniform.arraySize = values[2];
+		uniform.location = values[3];
+
+		// arrays are reported as "name[0]"
+		std::size_t bracket = uniform.name.find('[');
+		if (bracket != std::string::npos)
+			uniform.name.resize(bracket);
+
+		uniforms.push_back(uniform);
+	}
+
+	GLint nBlocks = 0;
+	glGetProgramInterfaceiv(id, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &nBlocks);
+
+	const GLenum blockProperties[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+	for (GLint i = 0; i < nBlocks; ++i)
+	{
+		GLint values[3];
+		glGetProgramResourceiv(id, GL_UNIFORM_BLOCK, i, 3, blockProperties, 3, nullptr, values);
+
+		ShaderUniformBlock block;
+		block.name = GetResourceName(id, GL_UNIFORM_BLOCK, i, values[0]);
+		block.index = (GLuint)i;
+		block.binding = values[1];
+		block.dataSize = values[2];
+		uniformBlocks.push_back(block);
+	}
+}
+
+///////////////////////////////////////////////////
+//	FindUniform(const char*, GLenum)
+//
+//	name: uniform name as written in the shader
+//	type: GL type the caller will upload
+//
+//	Return the location of an active uniform, warning when the
+//	name is not active or its type does not match; -1 is
+//	returned in that case, which glUniform* silently ignores
+///////////////////////////////////////////////////
+GLint ShaderProgram::FindUniform(const char* name, GLenum type) const
+{
+	for (const ShaderUniform& uniform : uniforms)
+	{
+		if (uniform.name == name)
+		{
+			if (uniform.type != type)
+			{
+				std::cout << "WARNING::SHADER::UNIFORM_TYPE_MISMATCH " << name << " in program " << id << std::endl;
+				return -1;
+			}
+			return uniform.location;
+		}
+	}
+
+	std::cout << "WARNING::SHADER::UNIFORM_NOT_FOUND " << name << " in program " << id << std::endl;
+	return -1;
+}
+
+///////////////////////////////////////////////////
+//	FindUniformBlock(const char*)
+//
+//	Return the index of an active uniform block, or
+//	GL_INVALID_INDEX with a warning
+///////////////////////////////////////////////////
+GLuint ShaderProgram::FindUniformBlock(const char* name) const
+{
+	for (const ShaderUniformBlock& block : uniformBlocks)
+	{
+		if (block.name == name)
+			return block.index;
+	}
+
+	std::cout << "WARNING::SHADER::UNIFORM_BLOCK_NOT_FOUND " << name << " in program " << id << std::endl;
+	return GL_INVALID_INDEX;
+}
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderprogram.h
+// ========
+// linked shader program with its active uniforms and uniform blocks
+//
+// The program is reflected once after linking so uniform locations can be
+// resolved at startup instead of looked up by name on every frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+// Active uniform outside of any uniform block
+struct ShaderUniform
+{
+	std::string name;       // without the "[0]" suffix of arrays
+	GLint location;
+	GLenum type;            // GL_FLOAT_VEC3, GL_FLOAT_MAT4, GL_SAMPLER_2D, ...
+	GLint arraySize;        // 1 for non-array uniforms
+};
+
+// Active uniform block
+struct ShaderUniformBlock
+{
+	std::string name;
+	GLuint index;
+	GLint binding;          // binding point assigned in the shader
+	GLint dataSize;         // minimum buffer size in bytes
+};
+
+class ShaderProgram
+{
+public:
+	GLuint id = 0;
+	std::vector<ShaderUniform> uniforms;
+	std::vector<ShaderUniformBlock> uniformBlocks;
+
+public:
+	void Reflect();
+	GLint FindUniform(const char* name, GLenum type) const;
+	GLuint FindUniformBlock(const char* name) const;
+};
@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.cpp
+// ========
+// cascaded shadow maps for the sun, with cascades cached between frames
+///////////////////////////////////////////////////////////////////////////////
+
+#include "shadowmaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	// blend between logarithmic (1) and uniform (0) split distances
+	const float SPLIT_LAMBDA = 0.75f;
+	// a cascade covers this much more than its slice, so small camera moves keep it valid
+	const float CACHE_MARGIN = 1.25f;
+	// a cascade this much larger than needed is refitted to regain resolution
+	const float SHRINK_RATIO = 2.0f;
+}
+
+///////////////////////////////////////////////////
+//	Create()
+//
+//	Create the depth texture array and the framebuffer the
+//	cascades are drawn through; return false when the
+//	framebuffer is not complete
+///////////////////////////////////////////////////
+bool CascadedShadowMap::Create()
+{
+	for (ShadowCascade& cascade : cascades)
+	{
+		cascade.radius = 0.0f;
+		cascade.stale = true;
+	}
+
+	glGenTextures(1, &depthTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, MAP_SIZE, MAP_SIZE, SHADOW_CASCADE_COUNT);
+
+	// hardware depth comparison; linear filtering blends the four nearest results
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	// outside of a cascade nothing is in shadow
+	const GLfloat border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::SHADOW::INCOMPLETE_FRAMEBUFFER 0x" << std::hex << status << std::dec << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	Update(FrameRing&, const glm::mat4&, const glm::mat4&, float, float, const glm::vec3&,
+//		const glm::vec3&, const glm::vec3&, bool, const glm::vec3&, const glm::vec3&)
+//
+//	ring: receives the constants of the frame
+//	view, projection: camera matrices of the frame
+//	nearPlane, farPlane: depth range of the projection
+//	lightDirection: unit vector pointing toward the sun
+//	sceneMin, sceneMax: box around every shadow caster
+//	sceneMoved: whether objects moved since the last update
+//	movedMin, movedMax: box around the old and new places of those objects
+//
+//	Split the frustum, refit the cascades whose slice left
+//	the sphere they cover, flag the cascades that have to be
+//	drawn and write and bind the constants the lit shaders read
+///////////////////////////////////////////////////
+void CascadedShadowMap::Update(FrameRing& ring, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+	const glm::vec3& lightDirection, const glm::vec3& sceneMin, const glm::vec3& sceneMax,
+	bool sceneMoved, const glm::vec3& movedMin, const glm::vec3& movedMax)
+{
+	bool lightChanged = lightDirection != this->lightDirection;
+	this->lightDirection = lightDirection;
+
+	// corners of the near and far planes in world space
+	glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+	glm::vec3 nearCorners[4], farCorners[4];
+	for (int corner = 0; corner < 4; ++corner)
+	{
+		float x = (corner & 1) ? 1.0f : -1.0f;
+		float y = (corner & 2) ? 1.0f : -1.0f;
+		glm::vec4 nearPoint = inverseViewProjection * glm::vec4(x, y, -1.0f, 1.0f);
+		glm::vec4 farPoint = inverseViewProjection * glm::vec4(x, y, 1.0f, 1.0f);
+		nearCorners[corner] = glm::vec3(nearPoint) / nearPoint.w;
+		farCorners[corner] = glm::vec3(farPoint) / farPoint.w;
+	}
+
+	ShadowConstants constants;
+	float splitNear = nearPlane;
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+	{
+		ShadowCascade& cascade = cascades[i];
+
+		// practical split scheme: mix of logarithmic and uniform distances
+		float fraction = (float)(i + 1) / SHADOW_CASCADE_COUNT;
+		float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		float uniformSplit = nearPlane + (farPlane - nearPlane) * fraction;
+		float splitFar = SPLIT_LAMBDA * logSplit + (1.0f - SPLIT_LAMBDA) * uniformSplit;
+		cascade.splitDepth = splitFar;
+
+		// view depth varies linearly along the frustum edges, so the slice corners interpolate them
+		glm::vec3 corners[8];
+		float tNear = (splitNear - nearPlane) / (farPlane - nearPlane);
+		float tFar = (splitFar - nearPlane) / (farPlane - nearPlane);
+		glm::vec3 center(0.0f);
+		for (int corner = 0; corner < 4; ++corner)
+		{
+			corners[corner] = nearCorners[corner] + (farCorners[corner] - nearCorners[corner]) * tNear;
+			corners[corner + 4] = nearCorners[corner] + (farCorners[corner] - nearCorners[corner]) * tFar;
+			center += corners[corner] + corners[corner + 4];
+		}
+		center /= 8.0f;
+
+		float radius = 0.0f;
+		for (const glm::vec3& corner : corners)
+			radius = std::max(radius, glm::length(corner - center));
+
+		bool contained = glm::length(center - cascade.center) + radius <= cascade.radius;
+		bool oversized = radius * CACHE_MARGIN * SHRINK_RATIO < cascade.radius;
+		bool refit = cascade.radius == 0.0f || lightChanged || !contained || oversized;
+		if (refit)
+			FitCascade(cascade, center, radius * CACHE_MARGIN, sceneMin, sceneMax);
+
+		bool movedInto = sceneMoved && Overlaps(cascade, movedMin, movedMax);
+
+		// a caster that moved past the near or far plane, say lifted above the old scene top,
+		// would be clipped away, so the depth range grows to take it in
+		if (movedInto && !refit && !DepthRangeCovers(cascade, movedMin, movedMax))
+			FitDepthRange(cascade, glm::min(sceneMin, movedMin), glm::max(sceneMax, movedMax));
+
+		cascade.stale = refit || movedInto;
+		if (cascade.stale)
+			++nDrawn;
+		else
+			++nReused;
+
+		constants.cascadeViewProjection[i] = cascade.viewProjection;
+		constants.cascadeSplits[i] = splitFar;
+		constants.cascadeTexelSizes[i] = 2.0f * cascade.radius / MAP_SIZE;
+		splitNear = splitFar;
+	}
+
+	ring.BindRange(GL_UNIFORM_BUFFER, SHADOW_CONSTANTS_BINDING, ring.Write(&constants, sizeof(ShadowConstants)));
+}
+
+///////////////////////////////////////////////////
+//	BeginCascade(int, RenderStateCache&)
+//
+//	Direct drawing into the layer of a cascade and clear it;
+//	the caller restores the framebuffer and viewport
+///////////////////////////////////////////////////
+void CascadedShadowMap::BeginCascade(int cascade, RenderStateCache& state) const
+{
+	state.BindFramebuffer(fbo);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+	glViewport(0, 0, MAP_SIZE, MAP_SIZE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+///////////////////////////////////////////////////
+//	BindTexture(RenderStateCache&)
+//
+//	Bind the cascades on the unit the lit shaders sample
+///////////////////////////////////////////////////
+void CascadedShadowMap::BindTexture(RenderStateCache& state) const
+{
+	state.BindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_2D_ARRAY, depthTexture);
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Release the depth texture and framebuffer
+///////////////////////////////////////////////////
+void CascadedShadowMap::Destroy()
+{
+	glDeleteTextures(1, &depthTexture);
+	glDeleteFramebuffers(1, &fbo);
+	depthTexture = 0;
+	fbo = 0;
+}
+
+///////////////////////////////////////////////////
+//	FitCascade(ShadowCascade&, const glm::vec3&, float, const glm::vec3&, const glm::vec3&)
+//
+//	Center the cascade on a sphere, snapped to whole texels
+//	so refits do not make shadow edges shimmer, and stretch
+//	its depth range over every caster of the scene
+///////////////////////////////////////////////////
+void CascadedShadowMap::FitCascade(ShadowCascade& cascade, const glm::vec3& center, float radius,
+	const glm::vec3& sceneMin, const glm::vec3& sceneMax) const
+{
+	glm::mat4 rotation = LightRotation();
+	float texelSize = 2.0f * radius / MAP_SIZE;
+
+	glm::vec3 lightCenter = glm::vec3(rotation * glm::vec4(center, 1.0f));
+	lightCenter.x = std::floor(lightCenter.x / texelSize) * texelSize;
+	lightCenter.y = std::floor(lightCenter.y / texelSize) * texelSize;
+
+	cascade.center = glm::vec3(glm::inverse(rotation) * glm::vec4(lightCenter, 1.0f));
+	cascade.radius = radius;
+
+	cascade.lightView = glm::translate(glm::mat4(1.0f), -lightCenter) * rotation;
+	FitDepthRange(cascade, sceneMin, sceneMax);
+}
+
+///////////////////////////////////////////////////
+//	FitDepthRange(ShadowCascade&, const glm::vec3&, const glm::vec3&)
+//
+//	Stretch the depth range of a fitted cascade over its
+//	sphere and a box of casters, leaving where it lies on
+//	the map as it is
+///////////////////////////////////////////////////
+void CascadedShadowMap::FitDepthRange(ShadowCascade& cascade, const glm::vec3& sceneMin, const glm::vec3& sceneMax) const
+{
+	// casters between the sun and the sphere have to be inside the depth range too
+	float radius = cascade.radius;
+	cascade.minZ = -radius;
+	cascade.maxZ = radius;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 point((corner & 1) ? sceneMax.x : sceneMin.x, (corner & 2) ? sceneMax.y : sceneMin.y, (corner & 4) ? sceneMax.z : sceneMin.z);
+		float z = (cascade.lightView * glm::vec4(point, 1.0f)).z;
+		cascade.minZ = std::min(cascade.minZ, z);
+		cascade.maxZ = std::max(cascade.maxZ, z);
+	}
+
+	cascade.viewProjection = glm::ortho(-radius, radius, -radius, radius, -cascade.maxZ, -cascade.minZ) * cascade.lightView;
+}
+
+///////////////////////////////////////////////////
+//	DepthRangeCovers(const ShadowCascade&, const glm::vec3&, const glm::vec3&)
+//
+//	Whether a world space box lies within the depth range
+//	the cascade was fitted with
+///////////////////////////////////////////////////
+bool CascadedShadowMap::DepthRangeCovers(const ShadowCascade& cascade, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+		float z = (cascade.lightView * glm::vec4(point, 1.0f)).z;
+		if (z < cascade.minZ || z > cascade.maxZ)
+			return false;
+	}
+	return true;
+}
+
+///////////////////////////////////////////////////
+//	LightRotation()
+//
+//	View rotation looking from the sun along its light
+///////////////////////////////////////////////////
+glm::mat4 CascadedShadowMap::LightRotation() const
+{
+	glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	return glm::lookAt(glm::vec3(0.0f), -lightDirection, up);
+}
+
+///////////////////////////////////////////////////
+//	Overlaps(const ShadowCascade&, const glm::vec3&, const glm::vec3&)
+//
+//	Whether a world space box can cast a shadow into the
+//	cascade, comparing their extents across the light
+///////////////////////////////////////////////////
+bool CascadedShadowMap::Overlaps(const ShadowCascade& cascade, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	glm::vec2 ndcMin(1.0f), ndcMax(-1.0f);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		glm::vec3 point((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec2 ndc = glm::vec2(cascade.viewProjection * glm::vec4(point, 1.0f));
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+
+	return ndcMax.x >= -1.0f && ndcMin.x <= 1.0f && ndcMax.y >= -1.0f && ndcMin.y <= 1.0f;
+}
@@ -0,0 +1,81 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadowmaps.h
+// ========
+// cascaded shadow maps for the sun, with cascades cached between frames
+//
+// The view frustum is split in depth and each slice gets its own layer of a
+// depth texture array. A cascade covers a sphere somewhat larger than its
+// slice, so the camera can move and turn inside it without the cascade's
+// light matrix changing; its depth is then reused instead of redrawn, and
+// only cascades whose matrix changed or that contain moved objects are drawn.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "framering.h"
+#include "renderstate.h"
+
+// Texture unit the shaders sample the cascades from, after the G-buffer units
+const GLint SHADOW_MAP_UNIT = 3;
+// Binding point of the ShadowConstants uniform block
+const GLuint SHADOW_CONSTANTS_BINDING = 1;
+// Depth slices of the view frustum, one vec4 component of cascadeSplits each
+const int SHADOW_CASCADE_COUNT = 4;
+
+// One depth slice of the view frustum
+struct ShadowCascade
+{
+	glm::vec3 center;           // world space sphere the cascade covers, texel aligned
+	float radius;               // 0 until the cascade is first fitted
+	float splitDepth;           // view depth where the cascade ends
+	glm::mat4 lightView;        // world to light space, centered on the sphere
+	float minZ;                 // light space depth range the casters were fitted in
+	float maxZ;
+	glm::mat4 viewProjection;   // world to light clip space
+	bool stale;                 // has to be drawn this frame
+};
+
+// Cascade matrices and splits read by the lit shaders, std140 layout
+struct ShadowConstants
+{
+	glm::mat4 cascadeViewProjection[SHADOW_CASCADE_COUNT];
+	glm::vec4 cascadeSplits;        // view depth where each cascade ends
+	glm::vec4 cascadeTexelSizes;    // world size of one shadow map texel, for the normal offset
+};
+
+class CascadedShadowMap
+{
+public:
+	static const int MAP_SIZE = 1024;
+
+	ShadowCascade cascades[SHADOW_CASCADE_COUNT];
+	glm::vec3 lightDirection = glm::vec3(0.0f);     // toward the sun, as of the last update
+
+	GLuint depthTexture = 0;        // GL_TEXTURE_2D_ARRAY, one layer per cascade
+	GLuint fbo = 0;
+
+	// Cascades drawn and reused since startup
+	int nDrawn = 0;
+	int nReused = 0;
+
+public:
+	bool Create();
+	void Update(FrameRing& ring, const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane,
+		const glm::vec3& lightDirection, const glm::vec3& sceneMin, const glm::vec3& sceneMax,
+		bool sceneMoved, const glm::vec3& movedMin, const glm::vec3& movedMax);
+	void BeginCascade(int cascade, RenderStateCache& state) const;
+	void BindTexture(RenderStateCache& state) const;
+	void Destroy();
+
+private:
+	void FitCascade(ShadowCascade& cascade, const glm::vec3& center, float radius,
+		const glm::vec3& sceneMin, const glm::vec3& sceneMax) const;
+	void FitDepthRange(ShadowCascade& cascade, const glm::vec3& sceneMin, const glm::vec3& sceneMax) const;
+	bool DepthRangeCovers(const ShadowCascade& cascade, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	glm::mat4 LightRotation() const;
+	bool Overlaps(const ShadowCascade& cascade, const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+};
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+// simulation.cpp
+// ========
+// fixed timestep simulation thread and the state it hands to the renderer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+
+///////////////////////////////////////////////////
+//	Start(double, const std::function<void(float)>&)
+//
+//	stepSeconds: simulated time of one step
+//	step: advances the simulation by the time it is given;
+//		called on the simulation thread only
+//
+//	Start the thread; it calls step once per stepSeconds
+//	of real time until Stop()
+///////////////////////////////////////////////////
+void FixedStepThread::Start(double stepSeconds, const std::function<void(float)>& step)
+{
+	this->stepSeconds = stepSeconds;
+	this->step = step;
+	nSteps = 0;
+	nDroppedSteps = 0;
+	running = true;
+	thread = std::thread(&FixedStepThread::Loop, this);
+}
+
+///////////////////////////////////////////////////
+//	Stop()
+//
+//	Let the current step finish and join the thread
+///////////////////////////////////////////////////
+void FixedStepThread::Stop()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+///////////////////////////////////////////////////
+//	Loop()
+//
+//	Body of the thread: run every step that is due, then
+//	sleep until the next one. Steps keep a fixed length, so
+//	the simulation does not depend on how fast frames go
+///////////////////////////////////////////////////
+void FixedStepThread::Loop()
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(stepSeconds));
+
+	Clock::time_point nextStep = Clock::now();
+	while (running)
+	{
+		int nDue = 0;
+		Clock::time_point now = Clock::now();
+		while (nextStep <= now && nDue < MAX_CATCH_UP_STEPS)
+		{
+			step((float)stepSeconds);
+			++nSteps;
+			++nDue;
+			nextStep += stepDuration;
+		}
+
+		// after a long stall, drop the steps past the catch-up limit instead of running them all at once
+		while (nextStep <= now)
+		{
+			++nDroppedSteps;
+			nextStep += stepDuration;
+		}
+
+		std::this_thread::sleep_until(nextStep);
+	}
+}
+
+///////////////////////////////////////////////////
+//	Add(double)
+//
+//	Record the latency of one input and update the
+//	statistics of the window
+///////////////////////////////////////////////////
+void LatencyStats::Add(double milliseconds)
+{
+	samples[next] = milliseconds;
+	next = (next + 1) % SAMPLE_COUNT;
+	nSamples = std::min(nSamples + 1, SAMPLE_COUNT);
+	lastMilliseconds = milliseconds;
+
+	double sum = 0.0;
+	maxMilliseconds = 0.0;
+	for (int i = 0; i < nSamples; ++i)
+	{
+		sum += samples[i];
+		maxMilliseconds = std::max(maxMilliseconds, samples[i]);
+	}
+	averageMilliseconds = sum / nSamples;
+}
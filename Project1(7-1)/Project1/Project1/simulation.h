@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+// simulation.h
+// ========
+// fixed timestep simulation thread and the state it hands to the renderer
+//
+// The simulation advances in steps of a fixed length on its own thread,
+// whatever the frame rate. After each step it publishes a copy of its state
+// into a double buffer; the render thread takes the newest copy at the start
+// of a frame, so the next state is prepared while the current frame is
+// submitted. The time from an input to the frame that shows it is gathered
+// into latency statistics.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+class FixedStepThread
+{
+public:
+	static const int MAX_CATCH_UP_STEPS = 5;    // steps run back to back after a hitch, the rest are dropped
+
+	std::atomic<long long> nSteps{ 0 };         // since Start()
+	std::atomic<long long> nDroppedSteps{ 0 };  // skipped because the thread fell too far behind
+
+public:
+	void Start(double stepSeconds, const std::function<void(float)>& step);
+	void Stop();
+
+private:
+	void Loop();
+
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	double stepSeconds = 0.0;
+	std::function<void(float)> step;
+};
+
+// Two copies of a state: the writer fills the one the reader is not using and
+// swaps them, the reader copies the newest. Neither waits on the other for
+// longer than one copy
+template <typename State>
+class StateDoubleBuffer
+{
+public:
+	// Writer: publish a new state
+	void Publish(const State& state)
+	{
+		// the back copy is never read, so it is written without the lock
+		states[1 - front] = state;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		front = 1 - front;
+		++version;
+	}
+
+	// Reader: copy the newest state; return its version, 0 before the first Publish()
+	unsigned Acquire(State& state)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		state = states[front];
+		return version;
+	}
+
+private:
+	State states[2];
+	int front = 0;
+	unsigned version = 0;
+	std::mutex mutex;
+};
+
+// Input to present latency over the last SAMPLE_COUNT inputs
+class LatencyStats
+{
+public:
+	static const int SAMPLE_COUNT = 128;
+
+	double lastMilliseconds = 0.0;
+	double averageMilliseconds = 0.0;
+	double maxMilliseconds = 0.0;
+	int nSamples = 0;                   // in the window, at most SAMPLE_COUNT
+
+public:
+	void Add(double milliseconds);
+
+private:
+	double samples[SAMPLE_COUNT] = {};
+	int next = 0;
+};
@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// workerpool.cpp
+// ========
+// fixed set of threads that run the jobs of one frame in parallel
+///////////////////////////////////////////////////////////////////////////////
+
+#include "workerpool.h"
+
+///////////////////////////////////////////////////
+//	Create(int)
+//
+//	nThreads: workers besides the calling thread, 0 runs
+//		every job on the caller
+//
+//	Start the workers, asleep until the first Run()
+///////////////////////////////////////////////////
+void WorkerPool::Create(int nThreads)
+{
+	closing = false;
+	for (int i = 0; i < nThreads; ++i)
+		threads.emplace_back(&WorkerPool::WorkerLoop, this);
+}
+
+///////////////////////////////////////////////////
+//	Run(int, const std::function<void(int)>&)
+//
+//	nJobs: number of jobs
+//	job: called once with each index below nJobs
+//
+//	Run the jobs on the workers and the calling thread,
+//	in no particular order, and wait until all are done
+///////////////////////////////////////////////////
+void WorkerPool::Run(int nJobs, const std::function<void(int)>& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		this->nJobs = nJobs;
+		nextJob = 0;
+		nBusy = (int)threads.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	RunJobs();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return nBusy == 0; });
+	this->job = nullptr;
+}
+
+///////////////////////////////////////////////////
+//	ThreadCount()
+//
+//	Return the number of threads jobs run on, the caller included
+///////////////////////////////////////////////////
+int WorkerPool::ThreadCount() const
+{
+	return (int)threads.size() + 1;
+}
+
+///////////////////////////////////////////////////
+//	Destroy()
+//
+//	Wake the workers to let them exit and join them
+///////////////////////////////////////////////////
+void WorkerPool::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+///////////////////////////////////////////////////
+//	WorkerLoop()
+//
+//	Body of a worker: sleep until a run starts, help with
+//	its jobs, report back and sleep again
+///////////////////////////////////////////////////
+void WorkerPool::WorkerLoop()
+{
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return closing || generation != seen; });
+			if (closing)
+				return;
+			seen = generation;
+		}
+
+		RunJobs();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--nBusy == 0)
+			finished.notify_one();
+	}
+}
+
+///////////////////////////////////////////////////
+//	RunJobs()
+//
+//	Take job indices until none are left
+///////////////////////////////////////////////////
+void WorkerPool::RunJobs()
+{
+	for (int i = nextJob++; i < nJobs; i = nextJob++)
+		(*job)(i);
+}
@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////
+// workerpool.h
+// ========
+// fixed set of threads that run the jobs of one frame in parallel
+//
+// Run() hands out job indices to the workers and to the calling thread until
+// every job is done, then returns; the workers sleep between calls. Jobs
+// must not touch GL, whose context belongs to the main thread.
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool
+{
+public:
+	void Create(int nThreads);
+	void Run(int nJobs, const std::function<void(int)>& job);
+	int ThreadCount() const;
+	void Destroy();
+
+private:
+	void WorkerLoop();
+	void RunJobs();
+
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;       // a run started or the pool is closing
+	std::condition_variable finished;   // the last worker left the run
+
+	const std::function<void(int)>* job = nullptr;
+	int nJobs = 0;
+	std::atomic<int> nextJob{ 0 };
+	int nBusy = 0;                      // workers still in the current run
+	unsigned generation = 0;            // counts runs, so a worker joins each run once
+	bool closing = false;
+};